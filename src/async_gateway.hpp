@@ -0,0 +1,189 @@
+#pragma once
+
+#include "async_matching_engine.hpp"
+#include <thread>
+#include <vector>
+#include <boost/unordered/unordered_flat_map.hpp>
+
+namespace matching{
+
+//strategy-thread side of a StrategySession, with the same topOfBook / newLimit /
+//cancel / amend surface as MatchingEngine so SimpleMarketMaker runs on it as is.
+//
+//Every order gets a client id at send time (returned instead of the engine id)
+//and stays that id for life, also across amends that re-queue at the engine.
+//A small state machine covers requests still in flight:
+//  PendingNew    -> Live on Accepted; a cancel meanwhile is sent on the ack
+//  Live          -> PendingAmend / PendingCancel
+//  PendingAmend  -> Live on Amended (engine id may change)
+//  any           -> gone on Done / Rejected / fully filled
+//An amend that cannot be sent yet (new or amend still in flight) becomes a
+//cancel + new order, which is what the engine would do for a price change anyway.
+//topOfBook answers from the last BBO report for subscribed symbols.
+//
+//Session is anything with requests.push(SessionRequest) and
+//reports.pop(ExecReport&): an in-process StrategySession or a shared-memory
+//client slot
+template<typename Session>
+class BasicAsyncOrderGateway{
+public:
+    explicit BasicAsyncOrderGateway(Session& session): session_(session) {}
+
+    void subscribe(SymbolId symbol){
+        if(symbol >= bbo_.size()){bbo_.resize(symbol + 1);}
+        SessionRequest req{};
+        req.type = RequestType::Subscribe;
+        req.event.symbol = symbol;
+        send(req);
+    }
+
+    TopOfBook topOfBook(SymbolId symbol) const{
+        if(symbol >= bbo_.size()){return TopOfBook{};}
+        return bbo_[symbol];
+    }
+
+    OrderId newLimit(SymbolId symbol, UserId user, Side side, Price price, Qty qty,
+                     TimeInForce tif = TimeInForce::GFD){
+        const OrderId id = next_client_id_++;
+        orders_[id] = ClientOrder{symbol, side, user, 0, qty, State::PendingNew, false};
+        SessionRequest req{};
+        req.type = RequestType::Order;
+        req.client_id = id;
+        req.event = InternalEvent{symbol, 0, price, qty, user, EventType::NewLimit, side, tif};
+        send(req);
+        return id;
+    }
+
+    bool cancel(SymbolId, OrderId id){
+        auto it = orders_.find(id);
+        if(it == orders_.end()){return false;}
+        ClientOrder& o = it->second;
+        if(o.state == State::Live){sendCancel(id, o);}
+        else{o.cancel_on_ack = true;} //pending: cancel once the engine id is known
+        return true;
+    }
+
+    OrderId amend(SymbolId symbol, OrderId id, Price price, Qty qty){
+        auto it = orders_.find(id);
+        if(it == orders_.end() || it->second.cancel_on_ack || it->second.state == State::PendingCancel){
+            return 0;
+        }
+        if(qty <= 0){cancel(symbol, id); return 0;}
+        ClientOrder& o = it->second;
+        if(o.state != State::Live){
+            const Side side = o.side;
+            const UserId user = o.user;
+            cancel(symbol, id);
+            return newLimit(symbol, user, side, price, qty);
+        }
+        o.state = State::PendingAmend;
+        SessionRequest req{};
+        req.type = RequestType::Amend;
+        req.client_id = id;
+        req.event = InternalEvent{o.symbol, o.engine_id, price, qty, o.user, EventType::Replace, o.side,
+                                  TimeInForce::GFD};
+        send(req);
+        return id;
+    }
+
+    //drains the report ring, applies each report to the order state, then hands
+    //it to on_report(const ExecReport&) (client_id = the id this gateway returned)
+    template<typename OnReport>
+    std::size_t poll(OnReport&& on_report){
+        std::size_t n = 0;
+        ExecReport r{};
+        while(session_.reports.pop(r)){
+            apply(r);
+            on_report(r);
+            ++n;
+        }
+        return n;
+    }
+
+    //orders the engine may still hold (including unacknowledged ones)
+    std::size_t openOrders() const{return orders_.size();}
+
+    //orders with a request the engine has not answered yet; quoting off a stale
+    //BBO while these are outstanding can cross our own in-flight orders
+    std::size_t inFlight() const{
+        std::size_t n = 0;
+        for(const auto& kv: orders_){n += kv.second.state != State::Live;}
+        return n;
+    }
+
+    std::uint64_t requestsSent() const{return requests_sent_;}
+
+private:
+    enum class State: std::uint8_t {PendingNew, Live, PendingAmend, PendingCancel};
+
+    struct ClientOrder{
+        SymbolId symbol;
+        Side side;
+        UserId user;
+        OrderId engine_id;
+        Qty open;
+        State state;
+        bool cancel_on_ack;
+    };
+
+    Session& session_;
+    boost::unordered_flat_map<OrderId, ClientOrder> orders_;
+    std::vector<TopOfBook> bbo_;
+    OrderId next_client_id_{1};
+    std::uint64_t requests_sent_{0};
+
+    void send(const SessionRequest& req){
+        while(!session_.requests.push(req)){std::this_thread::yield();}
+        ++requests_sent_;
+    }
+
+    void sendCancel(OrderId id, ClientOrder& o){
+        o.state = State::PendingCancel;
+        SessionRequest req{};
+        req.type = RequestType::Order;
+        req.client_id = id;
+        req.event = InternalEvent{o.symbol, o.engine_id, 0, 0, o.user, EventType::Cancel, o.side,
+                                  TimeInForce::GFD};
+        send(req);
+    }
+
+    void apply(const ExecReport& r){
+        if(r.type == ReportType::Bbo){
+            if(r.symbol >= bbo_.size()){bbo_.resize(r.symbol + 1);}
+            TopOfBook& tob = bbo_[r.symbol];
+            tob = TopOfBook{};
+            if(r.qty > 0){tob.best_bid = r.price; tob.bid_size = r.qty;}
+            if(r.ask_qty > 0){tob.best_ask = r.ask_price; tob.ask_size = r.ask_qty;}
+            if(tob.best_bid && tob.best_ask){tob.mid_price = (*tob.best_bid + *tob.best_ask) / 2;}
+            return;
+        }
+
+        auto it = orders_.find(r.client_id);
+        if(it == orders_.end()){return;}
+        ClientOrder& o = it->second;
+        switch(r.type){
+        case ReportType::Accepted:
+        case ReportType::Amended:
+            o.engine_id = r.order_id;
+            if(r.type == ReportType::Amended){o.open = r.qty;}
+            if(o.open <= 0){orders_.erase(it); return;}
+            o.state = State::Live;
+            if(o.cancel_on_ack){sendCancel(r.client_id, o);}
+            return;
+        case ReportType::Fill:
+            o.open -= r.qty;
+            if(o.open <= 0){orders_.erase(it);}
+            return;
+        case ReportType::Done:
+        case ReportType::Rejected:
+            orders_.erase(it);
+            return;
+        case ReportType::Bbo:
+            return;
+        }
+    }
+};
+
+using AsyncOrderGateway = BasicAsyncOrderGateway<StrategySession>;
+
+}
@@ -1,22 +1,131 @@
 #pragma once
 
 #include "matching_engine.hpp"
+#include "journal.hpp"
+#include "read_replica.hpp"
 #include <boost/lockfree/spsc_queue.hpp>
+#include <boost/unordered/unordered_flat_map.hpp>
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
 #include <thread>
 #include <utility>
+#include <vector>
 
 namespace matching{
 
+//--- strategy sessions: order ring in, execution-report ring out ---
+
+enum class RequestType: std::uint8_t {Order, Amend, Subscribe};
+
+//Order: event.type NewLimit/NewMarket/Cancel (Cancel targets engine id event.id)
+//Amend: event.symbol/id/price/qty, same semantics as MatchingEngine::amend
+//Subscribe: BBO reports for event.symbol (an immediate snapshot, then on change)
+struct SessionRequest{
+    RequestType type;
+    OrderId client_id; //strategy's own id, echoed on every report for the order
+    InternalEvent event;
+};
+
+enum class ReportType: std::uint8_t {
+    Accepted, //order_id = engine id; sent before any fill of the order
+    Amended,  //order_id = engine id after the amend, qty = open qty at the engine
+    Fill,     //price/qty of one execution
+    Done,     //left the book without further fills (cancelled, IOC remainder); qty = cancelled
+    Rejected, //unknown / not ours / already gone / refused by the engine (qty, price, risk)
+    Bbo       //price/qty = best bid, ask_price/ask_qty = best ask (qty 0 = empty side)
+};
+
+//seq / ts_ns are stamped when the engine sends the report
+struct ExecReport{
+    ReportType type;
+    Side side;
+    SymbolId symbol;
+    OrderId client_id;
+    OrderId order_id;
+    Price price;
+    Qty qty;
+    Price ask_price;
+    Qty ask_qty;
+    std::uint64_t seq{0};       //per session from 1, without gaps: a jump means reports were dropped
+    std::uint64_t trade_seq{0}; //Fill: the engine's trade seq (gapless across all trades)
+    std::int64_t ts_ns{0};      //engine event time (Fill: the trade's)
+};
+
+//one strategy thread's rings. The strategy is the only producer of requests and
+//the only consumer of reports; the engine thread is the other end of both
+class StrategySession{
+public:
+    explicit StrategySession(std::size_t capacity): requests(capacity), reports(capacity) {}
+
+    //strategy is gone: the engine stops waiting for room in its report ring
+    void close(){closed_.store(true, std::memory_order_release);}
+    bool closed() const{return closed_.load(std::memory_order_acquire);}
+
+    boost::lockfree::spsc_queue<SessionRequest> requests;
+    boost::lockfree::spsc_queue<ExecReport> reports;
+
+private:
+    std::atomic<bool> closed_{false};
+};
+
+//order-entry rings owned outside the engine (e.g. shared memory for client
+//processes). The engine thread polls live slots next to its own sessions; a slot
+//reported by maintain() has lost its client: the engine cancels the slot's
+//orders, then hands it back with release(). A slot whose report ring stays full
+//for kReportStallNs is treated the same way (the client is not draining)
+class SessionTransport{
+public:
+    virtual ~SessionTransport() = default;
+
+    virtual std::uint32_t slots() const = 0;
+    virtual bool live(std::uint32_t slot) const = 0;
+    virtual bool pop(std::uint32_t slot, SessionRequest& req) = 0;
+    virtual bool push(std::uint32_t slot, const ExecReport& r) = 0; //false: ring full
+    virtual void maintain(std::vector<std::uint32_t>& gone) = 0;
+    virtual void release(std::uint32_t slot) = 0;
+};
+
+//applied-event stream for a replica outside the process (e.g. a hot standby
+//tailing shared memory). replicate() runs on the engine thread after each
+//event is applied, idle() every so often from its loop, finish() once after
+//the worker stopped
+class EventReplicator{
+public:
+    virtual ~EventReplicator() = default;
+
+    virtual void replicate(const InternalEvent& e, const MatchingEngine& engine) = 0;
+    virtual void idle(const MatchingEngine& engine) = 0;
+    virtual void finish(const MatchingEngine& engine) = 0;
+};
+
 //single producer / single consumer async wrapper
 //uses value-based SPSC queue (no heap allocation per event)
+//
+//strategy threads connect() for their own session rings; the worker polls them
+//after the main queue, tracks which session owns each resting order and reports
+//acks, fills and BBO changes back. Symbols must be resolved before they are used
+//from a session (SymbolIds are not resolved on the engine thread).
+//An attached SessionTransport adds its slots as further sessions
 class AsyncMatchingEngine{
 public:
     using TradeCallback = MatchingEngine::TradeCallback;
+    static constexpr std::size_t kMaxSessions = 64;
+    static constexpr std::int64_t kReportStallNs = 100'000'000;
 
     explicit AsyncMatchingEngine(TradeCallback cb, std::size_t queue_capacity = 1 << 20)
-    : engine_(std::move(cb)), queue_(queue_capacity), running_(true),
-      worker_(&AsyncMatchingEngine::runLoop, this){}
+    : engine_([this, cb = std::move(cb)](const Trade& t){
+          if(cb){cb(t);}
+          routeFill(t);
+      }),
+      queue_(queue_capacity), running_(true){
+        //BBO reports for sessions; replaces any callback set through engine()
+        engine_.setBookUpdateCallback([this](SymbolId symbol){publishBbo(symbol);});
+        worker_ = std::thread(&AsyncMatchingEngine::runLoop, this);
+    }
 
     ~AsyncMatchingEngine(){stop();}
 
@@ -47,6 +156,45 @@ public:
         }
     }
 
+    //new strategy session; call from one control thread (not from strategies)
+    StrategySession& connect(std::size_t capacity = 1 << 16){
+        const std::size_t n = session_count_.load(std::memory_order_relaxed);
+        if(n == kMaxSessions){throw std::runtime_error("AsyncMatchingEngine: too many sessions");}
+        sessions_[n] = std::make_unique<StrategySession>(capacity);
+        session_count_.store(n + 1, std::memory_order_release);
+        return *sessions_[n];
+    }
+
+    //poll an external transport's slots too; it must outlive the worker (stop() first)
+    void attach(SessionTransport& transport){
+        transport_.store(&transport, std::memory_order_release);
+    }
+
+    //record every event the engine thread applies to a compact journal, stamped
+    //with the engine's event timestamp (TscClock, wall clock ns) so it can be
+    //replayed at its original pace, and with the id it was assigned so replay
+    //can remap ids.
+    //Call before submitting or connecting anything; closed by stop()
+    bool journalTo(const std::string& path){
+        auto writer = std::make_unique<CompactJournalWriter>();
+        if(!writer->open(path, LogWriterOptions{}, true)){return false;}
+        journal_owner_ = std::move(writer);
+        journal_.store(journal_owner_.get(), std::memory_order_release);
+        return true;
+    }
+
+    //hand every applied event to a read replica as well, so queries can go there
+    //instead of engine(); call before submitting or connecting anything. The
+    //replica must outlive the worker (stop() first)
+    void replicateTo(ReadReplica& replica){
+        replica_.store(&replica, std::memory_order_release);
+    }
+
+    //same for a replicator (hot standby feed); it must outlive the worker too
+    void replicateTo(EventReplicator& replicator){
+        replicator_.store(&replicator, std::memory_order_release);
+    }
+
     //stop the worker thread
     void stop(){
         bool expected = true;
@@ -56,6 +204,11 @@ public:
             sentinel.type = EventType::Stop;
             while(!queue_.push(sentinel)){std::this_thread::yield();}
             if(worker_.joinable()){worker_.join();}
+            if(journal_owner_){
+                journal_.store(nullptr, std::memory_order_relaxed);
+                journal_owner_->close();
+            }
+            if(EventReplicator* r = replicator_.load(std::memory_order_acquire)){r->finish(engine_);}
         }
     }
 
@@ -63,20 +216,332 @@ public:
     const MatchingEngine& engine() const{return engine_;}
 
 private:
+    struct SessionOrder{
+        std::uint32_t session;
+        OrderId client_id;
+        Side side;
+        Qty open;
+    };
+
     MatchingEngine engine_;
     boost::lockfree::spsc_queue<InternalEvent> queue_;
     std::atomic<bool> running_;
     std::thread worker_;
 
+    std::array<std::unique_ptr<StrategySession>, kMaxSessions> sessions_;
+    std::atomic<std::size_t> session_count_{0};
+    std::atomic<SessionTransport*> transport_{nullptr};
+    std::unique_ptr<CompactJournalWriter> journal_owner_;
+    std::atomic<CompactJournalWriter*> journal_{nullptr};
+    std::atomic<ReadReplica*> replica_{nullptr};
+    std::atomic<EventReplicator*> replicator_{nullptr};
+
+    //engine-thread only
+    std::vector<boost::unordered_flat_map<OrderId, SessionOrder>> session_orders_; //per symbol
+    std::vector<std::vector<std::uint32_t>> subscribers_; //per symbol
+    std::vector<std::uint32_t> gone_;
+    std::vector<std::uint32_t> stalled_; //transport slots that stopped draining reports
+    std::vector<std::uint64_t> report_seq_; //last report seq per session (transport slots after kMaxSessions)
+    std::uint32_t loops_{0};
+    ExecReport pending_accept_{}; //handleNew's order until the engine took it
+    bool accept_pending_{false};
+
     void runLoop(){
         InternalEvent ie{};
         while(true){
+            bool idle = true;
             while(queue_.pop(ie)){
-                if(ie.type == EventType::Stop){return;}
-                engine_.processInternal(ie);
+                if(ie.type == EventType::Stop){
+                    pollSessions();
+                    return;
+                }
+                record(ie, engine_.processInternal(ie));
+                idle = false;
+            }
+            if(pollSessions()){idle = false;}
+            if((++loops_ & 1023u) == 0){
+                maintainTransport();
+                if(EventReplicator* r = replicator_.load(std::memory_order_relaxed)){r->idle(engine_);}
             }
             //queue empty: check if we should exit
-            if(!running_.load(std::memory_order_relaxed)){break;}
+            if(idle && !running_.load(std::memory_order_relaxed)){break;}
+            if(idle){std::this_thread::yield();}
+        }
+    }
+
+    //journal / replicate an event just applied, with the id the book assigned it;
+    //unresolved symbols are rejected before they reach the book and are not part
+    //of its history
+    void record(const InternalEvent& e, OrderId assigned = 0){
+        CompactJournalWriter* j = journal_.load(std::memory_order_relaxed);
+        ReadReplica* replica = replica_.load(std::memory_order_relaxed);
+        EventReplicator* replicator = replicator_.load(std::memory_order_relaxed);
+        if((!j && !replica && !replicator) || e.symbol >= engine_.symbolIndex().size()){return;}
+        if(replica){replica->feed(e, engine_.symbolIndex());}
+        if(replicator){replicator->replicate(e, engine_);}
+        if(!j){return;}
+        j->append(e, engine_.symbolName(e.symbol), engine_.lastEventNs(), assigned);
+    }
+
+    //bounded batch per session so one busy strategy cannot starve the others
+    bool pollSessions(){
+        const std::size_t n = session_count_.load(std::memory_order_acquire);
+        bool any = false;
+        SessionRequest req{};
+        for(std::size_t s = 0; s < n; ++s){
+            for(int batch = 0; batch < 64 && sessions_[s]->requests.pop(req); ++batch){
+                handleRequest(static_cast<std::uint32_t>(s), req);
+                any = true;
+            }
+        }
+        if(SessionTransport* t = transport_.load(std::memory_order_acquire)){
+            const std::uint32_t slots = t->slots();
+            for(std::uint32_t slot = 0; slot < slots; ++slot){
+                if(!t->live(slot)){continue;}
+                for(int batch = 0; batch < 64 && t->pop(slot, req); ++batch){
+                    handleRequest(static_cast<std::uint32_t>(kMaxSessions) + slot, req);
+                    any = true;
+                }
+            }
+        }
+        return any;
+    }
+
+    //transport sessions whose client went away: cancel their resting orders and
+    //drop their subscriptions before the slot can be reused
+    void maintainTransport(){
+        SessionTransport* t = transport_.load(std::memory_order_acquire);
+        if(!t){return;}
+        gone_.clear();
+        t->maintain(gone_);
+        for(std::uint32_t slot: stalled_){
+            if(std::find(gone_.begin(), gone_.end(), slot) == gone_.end()){gone_.push_back(slot);}
+        }
+        stalled_.clear();
+        for(std::uint32_t slot: gone_){
+            const std::uint32_t s = static_cast<std::uint32_t>(kMaxSessions) + slot;
+            for(SymbolId symbol = 0; symbol < session_orders_.size(); ++symbol){
+                auto& subs = subscribers_[symbol];
+                subs.erase(std::remove(subs.begin(), subs.end(), s), subs.end());
+                auto& orders = session_orders_[symbol];
+                std::vector<OrderId> owned;
+                for(const auto& kv: orders){
+                    if(kv.second.session == s){owned.push_back(kv.first);}
+                }
+                for(OrderId id: owned){
+                    orders.erase(id);
+                    engine_.cancel(symbol, id);
+                    record(InternalEvent{symbol, id, 0, 0, 0, EventType::Cancel, Side::Buy, TimeInForce::GFD});
+                }
+            }
+            if(s < report_seq_.size()){report_seq_[s] = 0;} //the next client starts from 1
+            t->release(slot);
+        }
+    }
+
+    void handleRequest(std::uint32_t s, const SessionRequest& req){
+        const InternalEvent& e = req.event;
+        if(e.symbol >= engine_.symbolIndex().size()){
+            reject(s, req);
+            return;
+        }
+        if(e.symbol >= session_orders_.size()){
+            session_orders_.resize(e.symbol + 1);
+            subscribers_.resize(e.symbol + 1);
+        }
+        switch(req.type){
+        case RequestType::Subscribe:
+            subscribers_[e.symbol].push_back(s);
+            sendBbo(s, e.symbol);
+            return;
+        case RequestType::Amend:
+            handleAmend(s, req);
+            return;
+        case RequestType::Order:
+            break;
+        }
+        switch(e.type){
+        case EventType::NewLimit:
+        case EventType::NewMarket:
+            handleNew(s, req);
+            return;
+        case EventType::Cancel:
+            handleCancel(s, req);
+            return;
+        default:
+            reject(s, req);
+            return;
+        }
+    }
+
+    //register under the id the book will assign, so fills during matching are
+    //attributed before processInternal returns
+    OrderId predictedId(SymbolId symbol) const{
+        const auto* book = engine_.findBook(symbol);
+        return book ? book->nextOrderId() : OrderId{1};
+    }
+
+    bool resting(SymbolId symbol, OrderId id) const{
+        const auto* book = engine_.findBook(symbol);
+        return book && book->findOrder(id);
+    }
+
+    //Accepted goes out once the engine took the order: from routeFill ahead of
+    //its first fill, else after processInternal. An order the engine refuses
+    //(risk) does not take the predicted id and is Rejected instead
+    void handleNew(std::uint32_t s, const SessionRequest& req){
+        const InternalEvent& e = req.event;
+        if(e.qty <= 0 || (e.type == EventType::NewLimit && e.price <= 0)){
+            reject(s, req);
+            return;
+        }
+        auto& orders = session_orders_[e.symbol];
+        const OrderId id = predictedId(e.symbol);
+        orders[id] = SessionOrder{s, req.client_id, e.side, e.qty};
+        pending_accept_ = ExecReport{ReportType::Accepted, e.side, e.symbol, req.client_id, id, e.price, e.qty, 0, 0};
+        accept_pending_ = true;
+
+        const OrderId assigned = engine_.processInternal(e);
+        record(e, assigned);
+        if(assigned != id){
+            accept_pending_ = false;
+            orders.erase(id);
+            reject(s, req);
+            return;
+        }
+        acceptPending(s);
+
+        auto it = orders.find(id);
+        if(it != orders.end() && !resting(e.symbol, id)){
+            report(s, ExecReport{ReportType::Done, e.side, e.symbol, req.client_id, id, 0, it->second.open, 0, 0});
+            orders.erase(it);
+        }
+    }
+
+    void handleCancel(std::uint32_t s, const SessionRequest& req){
+        const InternalEvent& e = req.event;
+        auto& orders = session_orders_[e.symbol];
+        auto it = orders.find(e.id);
+        if(it == orders.end() || it->second.session != s){
+            reject(s, req);
+            return;
+        }
+        const bool cancelled = engine_.cancel(e.symbol, e.id);
+        record(e);
+        if(!cancelled){
+            reject(s, req);
+            return;
+        }
+        const SessionOrder o = it->second;
+        orders.erase(it);
+        report(s, ExecReport{ReportType::Done, o.side, e.symbol, o.client_id, e.id, 0, o.open, 0, 0});
+    }
+
+    void handleAmend(std::uint32_t s, const SessionRequest& req){
+        const InternalEvent& e = req.event;
+        auto& orders = session_orders_[e.symbol];
+        auto it = orders.find(e.id);
+        if(it == orders.end() || it->second.session != s){
+            reject(s, req);
+            return;
+        }
+        const SessionOrder o = it->second;
+        const OrderId predicted = predictedId(e.symbol);
+        orders[predicted] = SessionOrder{s, o.client_id, o.side, e.qty}; //if re-queued and matched
+
+        const OrderId id = engine_.amend(e.symbol, e.id, e.price, e.qty, e.user_id);
+        InternalEvent amended = e;
+        amended.type = EventType::Amend;
+        record(amended, id);
+
+        if(id == e.id){
+            orders.erase(predicted);
+            orders[id].open = e.qty;
+            report(s, ExecReport{ReportType::Amended, o.side, e.symbol, o.client_id, id, e.price, e.qty, 0, 0});
+            return;
+        }
+        orders.erase(e.id);
+        if(id == 0){
+            orders.erase(predicted);
+            report(s, ExecReport{ReportType::Done, o.side, e.symbol, o.client_id, e.id, 0, o.open, 0, 0});
+            return;
+        }
+        auto nit = orders.find(id);
+        const Qty open = nit == orders.end() ? 0 : nit->second.open;
+        report(s, ExecReport{ReportType::Amended, o.side, e.symbol, o.client_id, id, e.price, open, 0, 0});
+        if(nit != orders.end() && !resting(e.symbol, id)){orders.erase(nit);}
+    }
+
+    void routeFill(const Trade& t){
+        if(t.symbol_id >= session_orders_.size()){return;}
+        auto& orders = session_orders_[t.symbol_id];
+        if(orders.empty()){return;}
+        for(OrderId id: {t.buy_id, t.sell_id}){
+            auto it = orders.find(id);
+            if(it == orders.end()){continue;}
+            SessionOrder& o = it->second;
+            if(accept_pending_ && id == pending_accept_.order_id && t.symbol_id == pending_accept_.symbol){
+                acceptPending(o.session);
+            }
+            report(o.session, ExecReport{ReportType::Fill, o.side, t.symbol_id, o.client_id, id,
+                                         t.price, t.qty, 0, 0, 0, t.seq, t.ts_ns});
+            o.open -= t.qty;
+            if(o.open <= 0){orders.erase(it);}
+        }
+    }
+
+    void publishBbo(SymbolId symbol){
+        if(symbol >= subscribers_.size()){return;}
+        for(std::uint32_t s: subscribers_[symbol]){sendBbo(s, symbol);}
+    }
+
+    void sendBbo(std::uint32_t s, SymbolId symbol){
+        const TopOfBook tob = engine_.topOfBook(symbol);
+        ExecReport r{ReportType::Bbo, Side::Buy, symbol, 0, 0, 0, 0, 0, 0};
+        if(tob.best_bid){r.price = *tob.best_bid; r.qty = *tob.bid_size;}
+        if(tob.best_ask){r.ask_price = *tob.best_ask; r.ask_qty = *tob.ask_size;}
+        report(s, r);
+    }
+
+    void acceptPending(std::uint32_t s){
+        if(!accept_pending_){return;}
+        accept_pending_ = false;
+        report(s, pending_accept_);
+    }
+
+    void reject(std::uint32_t s, const SessionRequest& req){
+        const InternalEvent& e = req.event;
+        report(s, ExecReport{ReportType::Rejected, e.side, e.symbol, req.client_id, e.id, 0, 0, 0, 0});
+    }
+
+    //reports are never dropped: a full ring stalls the engine until the
+    //strategy drains it (or closes its session). Each session numbers its own
+    //reports; the timestamp is the current event's, so no clock is read here
+    void report(std::uint32_t s, ExecReport r){
+        if(s >= report_seq_.size()){report_seq_.resize(s + 1, 0);}
+        r.seq = ++report_seq_[s];
+        if(r.type != ReportType::Fill){r.ts_ns = engine_.lastEventNs();}
+        if(s >= kMaxSessions){
+            SessionTransport* t = transport_.load(std::memory_order_relaxed);
+            const std::uint32_t slot = s - static_cast<std::uint32_t>(kMaxSessions);
+            if(t->push(slot, r)){return;}
+            //a client process can be alive and still never drain: give up on it
+            //after a while and let maintainTransport drop the slot
+            if(std::find(stalled_.begin(), stalled_.end(), slot) != stalled_.end()){return;}
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(kReportStallNs);
+            while(!t->push(slot, r)){
+                if(!t->live(slot)){return;}
+                if(std::chrono::steady_clock::now() > deadline){
+                    stalled_.push_back(slot);
+                    return;
+                }
+                std::this_thread::yield();
+            }
+            return;
+        }
+        StrategySession& session = *sessions_[s];
+        while(!session.reports.push(r)){
+            if(session.closed()){return;}
             std::this_thread::yield();
         }
     }
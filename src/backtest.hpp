@@ -0,0 +1,290 @@
+#pragma once
+
+#include "matching_engine.hpp"
+#include "market_maker.hpp"
+#include "journal.hpp"
+#include "shadow_orders.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace matching{
+
+//one row of the stats time series (simulated time = index of the replayed event)
+struct BacktestSample{
+    std::uint64_t time{0};
+    std::uint32_t maker{0};
+    Qty position{0};
+    long long cash{0};
+    long long mtm_pnl{0};
+    Qty bid_filled_qty{0};
+    Qty ask_filled_qty{0};
+    std::uint64_t quote_updates{0};
+};
+
+struct BacktestResult{
+    std::vector<BacktestSample> samples;
+    std::vector<BacktestSample> final_stats; //one per maker
+    std::uint64_t events{0};
+    std::uint64_t trades{0};
+    double seconds{0};
+};
+
+//recorded cancel/replace/amend ids refer to the original session's id sequence,
+//which shifts once other orders are interleaved. Each original id maps to the
+//live one through a dense per-symbol vector (ids are small and sequential per
+//book). The vector only grows to a few times the ids seen so far; an id past
+//that (a journal that starts mid-session, or a corrupt ack) goes to a small
+//hash map instead. The original ids come from the journal's acks when it
+//recorded them, else they are inferred by replaying the original engine's
+//per-book allocation
+class TapeIdRemap{
+public:
+    static constexpr std::size_t kDenseSlack = 4096;
+
+    explicit TapeIdRemap(std::size_t num_symbols = 0): books_(num_symbols) {}
+
+    //before processing: rewrite a recorded target id to the live one
+    void resolve(InternalEvent& e){
+        if(e.type != EventType::Cancel && e.type != EventType::Replace && e.type != EventType::Amend){return;}
+        ensure(e.symbol);
+        Ids& ids = books_[e.symbol];
+        target_original_ = e.id;
+        target_live_ = 0;
+        const auto slot = static_cast<std::size_t>(e.id);
+        if(e.id > 0 && slot < ids.dense.size()){
+            target_live_ = ids.dense[slot];
+            ids.dense[slot] = 0;
+        }
+        else if(auto it = ids.sparse.find(e.id); it != ids.sparse.end()){
+            target_live_ = it->second;
+            ids.sparse.erase(it);
+        }
+        e.id = target_live_; //unknown or already cancelled: 0 fails as recorded
+    }
+
+    //after processing, with the id the original engine assigned (from the
+    //journal; 0 when it assigned none)
+    void assigned(const InternalEvent& e, OrderId live_id, OrderId recorded_id){
+        if(!assignsId(e.type) || live_id == 0 || recorded_id <= 0){return;}
+        ensure(e.symbol);
+        Ids& ids = books_[e.symbol];
+        ++ids.count;
+        const auto slot = static_cast<std::size_t>(recorded_id);
+        if(slot < ids.dense.size()){
+            ids.dense[slot] = live_id;
+            return;
+        }
+        const std::size_t limit = kDenseSlack + 4 * ids.count;
+        if(slot >= limit){
+            ids.sparse[recorded_id] = live_id;
+            return;
+        }
+        ids.dense.resize(std::min(limit, std::max(slot + 1, ids.dense.size() * 2)), 0);
+        ids.dense[slot] = live_id;
+    }
+
+    //after processing, inferring the original id: an amend that kept its place
+    //kept its id (and allocated none in the original run); anything else that
+    //takes an id took the book's next one
+    void assigned(const InternalEvent& e, OrderId live_id){
+        if(!assignsId(e.type)){return;}
+        ensure(e.symbol);
+        if(e.type == EventType::Amend){
+            if(live_id == 0){return;}
+            if(live_id == target_live_){
+                assigned(e, live_id, target_original_);
+                return;
+            }
+        }
+        assigned(e, live_id, books_[e.symbol].recorded_next++);
+    }
+
+private:
+    struct Ids{
+        std::vector<OrderId> dense; //original id -> live id, 0 = none
+        boost::unordered_flat_map<OrderId, OrderId> sparse;
+        OrderId recorded_next{1};
+        std::size_t count{0}; //ids assigned so far, bounds dense
+    };
+
+    std::vector<Ids> books_;
+    OrderId target_original_{0};
+    OrderId target_live_{0};
+
+    void ensure(SymbolId symbol){
+        if(symbol >= books_.size()){books_.resize(symbol + 1);}
+    }
+};
+
+enum class FillModel: std::uint8_t{
+    Book,          //maker orders rest in the replayed book and trade with history
+    QueuePosition  //maker orders are shadows that queue behind historical orders
+};
+
+namespace detail{
+
+inline void sampleMakers(const std::deque<SimpleMarketMaker>& makers, const MatchingEngine& engine,
+                         std::uint64_t time, std::vector<BacktestSample>& out){
+    for(std::size_t m = 0; m < makers.size(); ++m){
+        const MarketMakerStats& st = makers[m].stats();
+        BacktestSample s{};
+        s.time = time;
+        s.maker = static_cast<std::uint32_t>(m);
+        s.position = st.position;
+        s.cash = st.cash;
+        s.mtm_pnl = makers[m].markToMarket(engine);
+        s.bid_filled_qty = st.bid_filled_qty;
+        s.ask_filled_qty = st.ask_filled_qty;
+        s.quote_updates = st.quote_updates;
+        out.push_back(s);
+    }
+}
+
+inline BacktestResult runBookBacktest(const EventTape& tape,
+                                      const std::vector<MarketMakerConfig>& makers,
+                                      std::uint64_t sample_every){
+    BacktestResult result;
+
+    MarketMakerRouter router;
+    MatchingEngine engine([&](const Trade& t){
+        ++result.trades;
+        router.onTrade(t);
+    });
+    engine.setBookUpdateCallback([&](SymbolId sid){router.onBookUpdate(sid);});
+
+    //register tape symbols first so SymbolIds match the recorded ones
+    for(const auto& name: tape.symbols){engine.resolveSymbol(name);}
+
+    std::deque<SimpleMarketMaker> instances; //stable addresses for the router
+    for(const auto& config: makers){
+        instances.emplace_back(config);
+        router.attach(instances.back(), engine);
+    }
+
+    TapeIdRemap ids(engine.symbolIndex().size());
+
+    router.flush(engine);
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < tape.events.size(); ++i){
+        InternalEvent e = tape.events[i];
+        ids.resolve(e);
+        const OrderId live = engine.processInternal(e);
+        if(tape.assigned.empty()){ids.assigned(e, live);}
+        else{ids.assigned(e, live, tape.assigned[i]);}
+
+        router.flush(engine);
+
+        if(sample_every != 0 && (i + 1) % sample_every == 0){
+            sampleMakers(instances, engine, i + 1, result.samples);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    result.events = tape.events.size();
+    result.seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / 1e9;
+    sampleMakers(instances, engine, result.events, result.final_stats);
+    return result;
+}
+
+//history replays untouched (recorded ids stay valid, no remap); makers quote
+//through ShadowOrders and are filled from queue position
+inline BacktestResult runQueueBacktest(const EventTape& tape,
+                                       const std::vector<MarketMakerConfig>& makers,
+                                       std::uint64_t sample_every){
+    BacktestResult result;
+
+    ShadowOrders* shadows_ptr = nullptr;
+    std::vector<std::vector<std::uint32_t>> makers_by_symbol(tape.symbols.size());
+    std::vector<std::uint8_t> dirty;
+    std::vector<std::uint32_t> pending;
+    auto markDirty = [&](std::uint32_t m){
+        if(dirty[m]){return;}
+        dirty[m] = 1;
+        pending.push_back(m);
+    };
+
+    MatchingEngine engine([&](const Trade& t){
+        ++result.trades;
+        shadows_ptr->onTrade(t);
+    });
+    engine.setBookUpdateCallback([&](SymbolId sid){
+        if(sid >= makers_by_symbol.size()){return;}
+        for(std::uint32_t m: makers_by_symbol[sid]){markDirty(m);}
+    });
+    for(const auto& name: tape.symbols){engine.resolveSymbol(name);}
+
+    ShadowOrders shadows(engine);
+    shadows_ptr = &shadows;
+
+    std::deque<SimpleMarketMaker> instances;
+    for(const auto& config: makers){
+        auto m = static_cast<std::uint32_t>(instances.size());
+        instances.emplace_back(config);
+        instances.back().attach(engine);
+        SymbolId sid = instances.back().symbolId();
+        if(sid >= makers_by_symbol.size()){makers_by_symbol.resize(sid + 1);}
+        makers_by_symbol[sid].push_back(m);
+        dirty.push_back(0);
+        markDirty(m);
+    }
+
+    auto deliverFills = [&](){
+        for(const auto& f: shadows.fills()){
+            instances[f.maker].onFill(f.side, f.id, f.price, f.qty);
+            markDirty(f.maker);
+        }
+        shadows.fills().clear();
+    };
+    std::vector<std::uint32_t> flushing;
+    auto flush = [&](){
+        flushing.swap(pending);
+        for(std::uint32_t m: flushing){
+            dirty[m] = 0;
+            ShadowOrders::Gateway gw(shadows, m);
+            instances[m].onTick(gw);
+        }
+        flushing.clear();
+        deliverFills(); //marketable quotes: requote on the next batch
+    };
+
+    flush();
+
+    auto t0 = std::chrono::steady_clock::now();
+    for(std::size_t i = 0; i < tape.events.size(); ++i){
+        const InternalEvent& e = tape.events[i];
+        shadows.beginEvent(e);
+        engine.processInternal(e);
+        deliverFills();
+        flush();
+
+        if(sample_every != 0 && (i + 1) % sample_every == 0){
+            sampleMakers(instances, engine, i + 1, result.samples);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    result.events = tape.events.size();
+    result.seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / 1e9;
+    sampleMakers(instances, engine, result.events, result.final_stats);
+    return result;
+}
+
+}
+
+//replays a tape through a fresh MatchingEngine with market makers participating.
+//Runs at engine speed; makers requote after every replayed event (one batch each)
+inline BacktestResult runBacktest(const EventTape& tape,
+                                  const std::vector<MarketMakerConfig>& makers,
+                                  std::uint64_t sample_every,
+                                  FillModel fill_model = FillModel::Book){
+    if(fill_model == FillModel::QueuePosition){
+        return detail::runQueueBacktest(tape, makers, sample_every);
+    }
+    return detail::runBookBacktest(tape, makers, sample_every);
+}
+
+}
\ No newline at end of file
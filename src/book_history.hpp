@@ -0,0 +1,270 @@
+#pragma once
+
+#include "journal.hpp"
+#include "log_writer.hpp"
+#include "matching_engine.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace matching{
+
+//book checkpoint file: every book's resting orders at chosen points of a journal
+//  header:      "MJCK", u32 version
+//  checkpoints: u64 seq (events applied), u32 book count, then per book:
+//               u32 symbol, i64 next order id, u64 n, Order[n] (forEachOrder order)
+//  footer:      BookCheckpointIndex per checkpoint, u64 count, "MJCX"
+inline constexpr char kCheckpointMagic[4] = {'M', 'J', 'C', 'K'};
+inline constexpr char kCheckpointFooterMagic[4] = {'M', 'J', 'C', 'X'};
+inline constexpr std::uint32_t kCheckpointVersion = 1;
+
+struct BookCheckpointIndex{
+    std::uint64_t seq;
+    std::uint64_t offset; //file offset of the checkpoint
+};
+
+class BookCheckpointWriter{
+public:
+    ~BookCheckpointWriter(){close();}
+
+    bool open(const std::string& path){
+        if(!out_.open(path)){return false;}
+        out_.append(kCheckpointMagic, sizeof(kCheckpointMagic));
+        out_.appendPod(kCheckpointVersion);
+        index_.clear();
+        open_ = true;
+        return true;
+    }
+
+    //snapshot of every book after seq journal events
+    void add(std::uint64_t seq, const MatchingEngine& engine){
+        index_.push_back(BookCheckpointIndex{seq, out_.bytesAppended()});
+        const auto symbols = static_cast<SymbolId>(engine.symbolIndex().size());
+        std::uint32_t books = 0;
+        for(SymbolId s = 0; s < symbols; ++s){books += engine.findBook(s) != nullptr;}
+        out_.appendPod(seq);
+        out_.appendPod(books);
+        for(SymbolId s = 0; s < symbols; ++s){
+            const auto* book = engine.findBook(s);
+            if(!book){continue;}
+            orders_.clear();
+            book->forEachOrder([&](const Order& o){orders_.push_back(o);});
+            out_.appendPod(s);
+            out_.appendPod(book->nextOrderId());
+            out_.appendPod(static_cast<std::uint64_t>(orders_.size()));
+            out_.append(orders_.data(), orders_.size() * sizeof(Order));
+        }
+    }
+
+    bool close(){
+        if(!open_){return true;}
+        open_ = false;
+        for(const auto& c: index_){out_.appendPod(c);}
+        out_.appendPod(static_cast<std::uint64_t>(index_.size()));
+        out_.append(kCheckpointFooterMagic, sizeof(kCheckpointFooterMagic));
+        out_.close();
+        return out_.error() == 0;
+    }
+
+    std::size_t count() const{return index_.size();}
+
+private:
+    LogWriter out_;
+    std::vector<BookCheckpointIndex> index_;
+    std::vector<Order> orders_;
+    bool open_{false};
+};
+
+class BookCheckpointReader{
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    bool open(const std::string& path){
+        in_.open(path, std::ios::binary);
+        if(!in_){return false;}
+        char magic[4] = {};
+        std::uint32_t version = 0;
+        in_.read(magic, sizeof(magic));
+        in_.read(reinterpret_cast<char*>(&version), sizeof(version));
+        if(!in_ || std::memcmp(magic, kCheckpointMagic, sizeof(magic)) != 0 || version != kCheckpointVersion){
+            return false;
+        }
+        in_.seekg(0, std::ios::end);
+        const auto size = static_cast<std::uint64_t>(in_.tellg());
+        std::uint64_t count = 0;
+        if(size < 8 + sizeof(count) + sizeof(magic)){return false;}
+        in_.seekg(static_cast<std::streamoff>(size - sizeof(count) - sizeof(magic)));
+        in_.read(reinterpret_cast<char*>(&count), sizeof(count));
+        in_.read(magic, sizeof(magic));
+        if(!in_ || std::memcmp(magic, kCheckpointFooterMagic, sizeof(magic)) != 0 ||
+           count > (size - 8) / sizeof(BookCheckpointIndex)){
+            return false;
+        }
+        index_.resize(count);
+        in_.seekg(static_cast<std::streamoff>(size - sizeof(count) - sizeof(magic) - count * sizeof(BookCheckpointIndex)));
+        in_.read(reinterpret_cast<char*>(index_.data()), static_cast<std::streamsize>(count * sizeof(BookCheckpointIndex)));
+        return static_cast<bool>(in_);
+    }
+
+    std::size_t count() const{return index_.size();}
+    std::uint64_t seq(std::size_t i) const{return index_[i].seq;}
+
+    //last checkpoint at or before seq, npos if none
+    std::size_t nearest(std::uint64_t seq) const{
+        auto it = std::upper_bound(index_.begin(), index_.end(), seq,
+                                   [](std::uint64_t v, const BookCheckpointIndex& c){return v < c.seq;});
+        return it == index_.begin() ? npos : static_cast<std::size_t>(it - index_.begin()) - 1;
+    }
+
+    //the symbol's book in checkpoint i; false (orders empty) when it had none yet
+    bool loadBook(std::size_t i, SymbolId symbol, OrderId& next_id, std::vector<Order>& orders){
+        orders.clear();
+        in_.clear();
+        in_.seekg(static_cast<std::streamoff>(index_[i].offset + sizeof(std::uint64_t)));
+        std::uint32_t books = 0;
+        in_.read(reinterpret_cast<char*>(&books), sizeof(books));
+        for(std::uint32_t b = 0; b < books && in_; ++b){
+            SymbolId s = 0;
+            std::uint64_t n = 0;
+            in_.read(reinterpret_cast<char*>(&s), sizeof(s));
+            in_.read(reinterpret_cast<char*>(&next_id), sizeof(next_id));
+            in_.read(reinterpret_cast<char*>(&n), sizeof(n));
+            if(s != symbol){
+                in_.seekg(static_cast<std::streamoff>(n * sizeof(Order)), std::ios::cur);
+                continue;
+            }
+            orders.resize(n);
+            in_.read(reinterpret_cast<char*>(orders.data()), static_cast<std::streamsize>(n * sizeof(Order)));
+            return static_cast<bool>(in_);
+        }
+        return false;
+    }
+
+private:
+    std::ifstream in_;
+    std::vector<BookCheckpointIndex> index_;
+};
+
+namespace detail{
+
+//registers the journal's symbols engine does not know yet, in id order, so ids
+//match the journal's; ids the journal never used get a placeholder name
+inline void resolveJournalSymbols(MatchingEngine& engine, const std::vector<std::string>& names){
+    for(auto s = static_cast<SymbolId>(engine.symbolIndex().size()); s < names.size(); ++s){
+        engine.resolveSymbol(names[s].empty() ? "#" + std::to_string(s) : names[s]);
+    }
+}
+
+}
+
+//replays a compact journal into engine, adding a checkpoint every `every`
+//events (and at the end); returns the number of checkpoints, 0 on failure
+inline std::size_t writeBookCheckpoints(const std::string& journal_path, const std::string& out_path,
+                                        std::uint64_t every){
+    CompactJournalReader reader;
+    BookCheckpointWriter writer;
+    if(!reader.open(journal_path) || !writer.open(out_path) || every == 0){return 0;}
+    MatchingEngine engine;
+    std::vector<InternalEvent> events;
+    std::uint64_t seq = 0;
+    for(std::size_t b = 0; b < reader.blockCount(); ++b){
+        events.clear();
+        if(!reader.readBlock(b, events)){return 0;}
+        for(const InternalEvent& e: events){
+            //a journal that was not closed defines its symbols as blocks are decoded
+            detail::resolveJournalSymbols(engine, reader.symbols());
+            if(e.symbol >= reader.symbols().size()){return 0;} //event for an undefined symbol
+            engine.processInternal(e);
+            if(++seq % every == 0){writer.add(seq, engine);}
+        }
+    }
+    if(seq % every != 0){writer.add(seq, engine);}
+    const std::size_t n = writer.count();
+    return writer.close() ? n : 0;
+}
+
+struct BookQueryStats{
+    std::uint64_t from_seq{0};      //checkpoint the replay started from (0: journal start)
+    std::uint64_t events_applied{0};
+    std::size_t blocks_decoded{0};
+};
+
+//historical L3 book for one symbol: the nearest checkpoint at or before the
+//requested sequence number, then only that symbol's events, read from the
+//blocks the journal's symbol index lists. Per-book order ids make the
+//single-symbol replay reproduce the original ids
+class BookHistory{
+public:
+    //checkpoint_path may be empty: replays from the journal start
+    bool open(const std::string& journal_path, const std::string& checkpoint_path = ""){
+        if(!journal_.open(journal_path)){return false;}
+        has_checkpoints_ = !checkpoint_path.empty();
+        return !has_checkpoints_ || checkpoints_.open(checkpoint_path);
+    }
+
+    std::uint64_t events() const{return journal_.eventCount();}
+    const std::vector<std::string>& symbols() const{return journal_.symbols();}
+
+    //rebuilds the symbol's book in engine as it stood after the first seq events.
+    //engine: fresh, or used only for bookAt on this journal (symbol ids follow it)
+    bool bookAt(SymbolId symbol, std::uint64_t seq, MatchingEngine& engine, BookQueryStats* stats = nullptr){
+        BookQueryStats st;
+        seq = std::min(seq, events());
+        detail::resolveJournalSymbols(engine, symbols());
+        if(symbol >= engine.symbolIndex().size()){return false;}
+
+        OrderId next_id = 1;
+        orders_.clear();
+        const std::size_t c = has_checkpoints_ ? checkpoints_.nearest(seq) : BookCheckpointReader::npos;
+        if(c != BookCheckpointReader::npos){
+            st.from_seq = checkpoints_.seq(c);
+            if(!checkpoints_.loadBook(c, symbol, next_id, orders_)){next_id = 1;}
+        }
+        engine.restoreBook(symbol, next_id, orders_);
+
+        if(st.from_seq < seq){
+            const std::size_t first = journal_.blockOf(st.from_seq);
+            const std::size_t last = journal_.blockOf(seq - 1);
+            const std::vector<std::uint32_t>* blocks = journal_.symbolBlocks(symbol);
+            auto apply = [&](std::size_t b){
+                events_.clear();
+                if(!journal_.readBlock(b, events_)){return false;}
+                ++st.blocks_decoded;
+                const std::uint64_t base = journal_.block(b).first_event;
+                for(std::size_t i = 0; i < events_.size(); ++i){
+                    const std::uint64_t n = base + i;
+                    if(n < st.from_seq || events_[i].symbol != symbol){continue;}
+                    if(n >= seq){break;}
+                    engine.processInternal(events_[i]);
+                    ++st.events_applied;
+                }
+                return true;
+            };
+            if(blocks){
+                auto it = std::lower_bound(blocks->begin(), blocks->end(), static_cast<std::uint32_t>(first));
+                for(; it != blocks->end() && *it <= last; ++it){
+                    if(!apply(*it)){return false;}
+                }
+            }
+            else{
+                for(std::size_t b = first; b <= last; ++b){
+                    if(!apply(b)){return false;}
+                }
+            }
+        }
+        if(stats){*stats = st;}
+        return true;
+    }
+
+private:
+    CompactJournalReader journal_;
+    BookCheckpointReader checkpoints_;
+    bool has_checkpoints_{false};
+    std::vector<Order> orders_;
+    std::vector<InternalEvent> events_;
+};
+
+}
@@ -0,0 +1,359 @@
+#pragma once
+
+#include "async_gateway.hpp"
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <boost/unordered/unordered_flat_map.hpp>
+
+namespace matching{
+
+//coroutine frames come from a per-thread size-class free list: frames are
+//created and destroyed on the strategy thread, and after warm-up a place /
+//nextFill round trip touches the heap zero times
+class FramePool{
+public:
+    FramePool() = default;
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    static FramePool& local(){
+        thread_local FramePool pool;
+        return pool;
+    }
+
+    void* allocate(std::size_t bytes){
+        const std::size_t c = classOf(bytes);
+        if(c >= kClasses){return ::operator new(bytes);}
+        if(!free_[c]){grow(c);}
+        FreeNode* n = free_[c];
+        free_[c] = n->next;
+        return n;
+    }
+
+    void deallocate(void* p, std::size_t bytes) noexcept{
+        const std::size_t c = classOf(bytes);
+        if(c >= kClasses){::operator delete(p); return;}
+        FreeNode* n = static_cast<FreeNode*>(p);
+        n->next = free_[c];
+        free_[c] = n;
+    }
+
+private:
+    struct FreeNode{FreeNode* next;};
+    static constexpr std::size_t kGranule = 64;
+    static constexpr std::size_t kClasses = 32; //frames up to 2 KiB
+    static constexpr std::size_t kBlocksPerChunk = 64;
+
+    std::array<FreeNode*, kClasses> free_{};
+    std::vector<std::unique_ptr<std::byte[]>> chunks_;
+
+    static std::size_t classOf(std::size_t bytes){return (bytes + kGranule - 1) / kGranule - 1;}
+
+    void grow(std::size_t c){
+        const std::size_t block = (c + 1) * kGranule;
+        chunks_.emplace_back(new std::byte[block * kBlocksPerChunk]);
+        std::byte* base = chunks_.back().get();
+        for(std::size_t i = kBlocksPerChunk; i-- > 0;){
+            FreeNode* n = reinterpret_cast<FreeNode*>(base + i * block);
+            n->next = free_[c];
+            free_[c] = n;
+        }
+    }
+};
+
+template<typename T = void>
+class Task;
+
+namespace detail{
+
+struct TaskPromiseBase{
+    std::coroutine_handle<> continuation{};
+    std::exception_ptr error;
+    bool detached{false};
+
+    static void* operator new(std::size_t bytes){return FramePool::local().allocate(bytes);}
+    static void operator delete(void* p, std::size_t bytes) noexcept{FramePool::local().deallocate(p, bytes);}
+
+    std::suspend_always initial_suspend() noexcept{return {};}
+
+    //symmetric transfer back to the awaiting task; detached tasks free themselves
+    struct FinalAwaiter{
+        bool await_ready() noexcept{return false;}
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept{
+            TaskPromiseBase& p = h.promise();
+            if(p.detached){
+                h.destroy();
+                return std::noop_coroutine();
+            }
+            return p.continuation ? p.continuation : std::noop_coroutine();
+        }
+        void await_resume() noexcept{}
+    };
+    FinalAwaiter final_suspend() noexcept{return {};}
+
+    void unhandled_exception(){
+        if(detached){throw;} //nobody awaits it: surface in the resumer (poll)
+        error = std::current_exception();
+    }
+};
+
+template<typename T>
+struct TaskPromise: TaskPromiseBase{
+    std::optional<T> value;
+    Task<T> get_return_object();
+    template<typename U>
+    void return_value(U&& v){value.emplace(std::forward<U>(v));}
+};
+
+template<>
+struct TaskPromise<void>: TaskPromiseBase{
+    Task<void> get_return_object();
+    void return_void(){}
+};
+
+}
+
+//lazily started coroutine; co_await runs it to completion (symmetric transfer,
+//no extra resumption hop). Top-level tasks are handed to CoroGateway::spawn
+template<typename T>
+class [[nodiscard]] Task{
+public:
+    using promise_type = detail::TaskPromise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+    explicit Task(Handle h): h_(h) {}
+    Task(Task&& other) noexcept: h_(std::exchange(other.h_, {})) {}
+    Task& operator=(Task&& other) noexcept{
+        if(this != &other){
+            if(h_){h_.destroy();}
+            h_ = std::exchange(other.h_, {});
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task(){if(h_){h_.destroy();}}
+
+    bool await_ready() const noexcept{return false;}
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept{
+        h_.promise().continuation = awaiting;
+        return h_;
+    }
+    T await_resume(){
+        if(h_.promise().error){std::rethrow_exception(h_.promise().error);}
+        if constexpr(!std::is_void_v<T>){return std::move(*h_.promise().value);}
+    }
+
+    Handle release(){return std::exchange(h_, {});}
+
+private:
+    Handle h_;
+};
+
+namespace detail{
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object(){return Task<T>(Task<T>::Handle::from_promise(*this));}
+inline Task<void> TaskPromise<void>::get_return_object(){
+    return Task<void>(Task<void>::Handle::from_promise(*this));
+}
+}
+
+struct PlaceResult{
+    OrderId id{0};      //client id (valid while the order lives)
+    bool accepted{false};
+};
+
+//fills accumulated since the previous nextFill on the same order
+struct FillUpdate{
+    Qty qty{0};
+    Price last_price{0};
+    Qty open{0};
+    bool done{false}; //order is off the book (filled, cancelled or rejected)
+};
+
+//coroutine surface over AsyncOrderGateway, driven by poll() on the strategy
+//thread: each execution report updates the order's record and resumes the
+//coroutine waiting on it. Fills that arrive while nobody waits are folded into
+//the record and returned by the next nextFill. A finished order's record is
+//dropped when its final update is read
+class CoroGateway{
+public:
+    explicit CoroGateway(StrategySession& session, std::size_t expected_orders = 1024):
+        gw_(session){
+        records_.reserve(expected_orders);
+    }
+
+    CoroGateway(const CoroGateway&) = delete;
+    CoroGateway& operator=(const CoroGateway&) = delete;
+
+    void subscribe(SymbolId symbol){
+        gw_.subscribe(symbol);
+        if(symbol >= bbo_waiters_.size()){bbo_waiters_.resize(symbol + 1);}
+    }
+
+    TopOfBook topOfBook(SymbolId symbol) const{return gw_.topOfBook(symbol);}
+
+    //starts a top-level task now; its frame is freed when it finishes
+    void spawn(Task<> task){
+        auto h = task.release();
+        h.promise().detached = true;
+        h.resume();
+    }
+
+    struct PlaceAwaiter{
+        CoroGateway& gw;
+        SymbolId symbol;
+        UserId user;
+        Side side;
+        Price price;
+        Qty qty;
+        TimeInForce tif;
+        OrderId id{0};
+
+        bool await_ready() const noexcept{return gw.stopping_;}
+        void await_suspend(std::coroutine_handle<> h){
+            id = gw.gw_.newLimit(symbol, user, side, price, qty, tif);
+            OrderRecord& r = gw.records_[id];
+            r.open = qty;
+            r.waiter = h;
+        }
+        PlaceResult await_resume(){
+            if(id == 0){return PlaceResult{};}
+            auto it = gw.records_.find(id);
+            const bool accepted = it->second.accepted;
+            if(!accepted){gw.records_.erase(it);}
+            return PlaceResult{accepted ? id : OrderId{0}, accepted};
+        }
+    };
+
+    //resumes with the engine's answer: accepted (id valid) or rejected
+    PlaceAwaiter place(SymbolId symbol, UserId user, Side side, Price price, Qty qty,
+                       TimeInForce tif = TimeInForce::GFD){
+        return PlaceAwaiter{*this, symbol, user, side, price, qty, tif};
+    }
+
+    struct FillAwaiter{
+        CoroGateway& gw;
+        OrderId id;
+
+        bool await_ready() const{
+            auto it = gw.records_.find(id);
+            return it == gw.records_.end() || it->second.unread_qty > 0 || it->second.done;
+        }
+        void await_suspend(std::coroutine_handle<> h){gw.records_.find(id)->second.waiter = h;}
+        FillUpdate await_resume(){
+            auto it = gw.records_.find(id);
+            if(it == gw.records_.end()){return FillUpdate{0, 0, 0, true};}
+            OrderRecord& r = it->second;
+            FillUpdate u{r.unread_qty, r.last_price, r.open, r.done};
+            r.unread_qty = 0;
+            if(r.done){gw.records_.erase(it);}
+            return u;
+        }
+    };
+
+    //next fill(s) on an accepted order, or its end
+    FillAwaiter nextFill(OrderId id){return FillAwaiter{*this, id};}
+
+    struct BboAwaiter{
+        CoroGateway& gw;
+        SymbolId symbol;
+
+        bool await_ready() const noexcept{return gw.stopping_ || symbol >= gw.bbo_waiters_.size();}
+        void await_suspend(std::coroutine_handle<> h){gw.bbo_waiters_[symbol].push_back(h);}
+        TopOfBook await_resume() const{return gw.gw_.topOfBook(symbol);}
+    };
+
+    //next BBO report for a subscribed symbol
+    BboAwaiter nextBbo(SymbolId symbol){return BboAwaiter{*this, symbol};}
+
+    //the outcome arrives through nextFill (done)
+    bool cancel(SymbolId symbol, OrderId id){return gw_.cancel(symbol, id);}
+
+    //drains reports and resumes waiting coroutines; returns reports handled
+    std::size_t poll(){return gw_.poll([this](const ExecReport& r){dispatch(r);});}
+
+    //cancel every open order, wake BBO waiters and keep polling until the engine
+    //holds nothing for us, so tasks that check stopping() can run to completion
+    void shutdown(){
+        stopping_ = true;
+        wakeAllBbo();
+        while(gw_.openOrders() != 0){
+            for(auto& kv: records_){
+                if(!kv.second.done){gw_.cancel(0, kv.first);}
+            }
+            if(poll() == 0){std::this_thread::yield();}
+        }
+    }
+
+    bool stopping() const{return stopping_;}
+    const AsyncOrderGateway& orders() const{return gw_;}
+
+private:
+    struct OrderRecord{
+        std::coroutine_handle<> waiter{};
+        Qty unread_qty{0};
+        Price last_price{0};
+        Qty open{0};
+        bool accepted{false};
+        bool done{false};
+    };
+
+    AsyncOrderGateway gw_;
+    boost::unordered_flat_map<OrderId, OrderRecord> records_;
+    std::vector<std::vector<std::coroutine_handle<>>> bbo_waiters_; //per symbol
+    std::vector<std::coroutine_handle<>> waking_;
+    bool stopping_{false};
+
+    void dispatch(const ExecReport& r){
+        if(r.type == ReportType::Bbo){
+            if(r.symbol < bbo_waiters_.size()){wakeBbo(r.symbol);}
+            return;
+        }
+        auto it = records_.find(r.client_id);
+        if(it == records_.end()){return;}
+        OrderRecord& rec = it->second;
+        switch(r.type){
+        case ReportType::Accepted:
+            rec.accepted = true;
+            break;
+        case ReportType::Amended:
+            rec.open = r.qty;
+            break;
+        case ReportType::Fill:
+            rec.unread_qty += r.qty;
+            rec.last_price = r.price;
+            rec.open -= r.qty;
+            rec.done = rec.open <= 0;
+            break;
+        case ReportType::Done:
+        case ReportType::Rejected:
+            rec.open = 0;
+            rec.done = true;
+            break;
+        case ReportType::Bbo:
+            break;
+        }
+        //resume last: the coroutine may insert into records_ and invalidate rec
+        if(auto h = std::exchange(rec.waiter, {})){h.resume();}
+    }
+
+    void wakeBbo(SymbolId symbol){
+        waking_.swap(bbo_waiters_[symbol]); //waiters re-registering land in the fresh list
+        for(auto h: waking_){h.resume();}
+        waking_.clear();
+    }
+
+    void wakeAllBbo(){
+        for(SymbolId s = 0; s < bbo_waiters_.size(); ++s){wakeBbo(s);}
+    }
+};
+
+}
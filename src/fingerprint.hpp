@@ -0,0 +1,131 @@
+#pragma once
+
+#include "matching_engine.hpp"
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace matching{
+
+//order-sensitive 64-bit stream hash for regression checks (not cryptographic):
+//every value goes through the splitmix64 finalizer, so a changed, dropped or
+//reordered value changes the result
+class StreamHash{
+public:
+    template<typename T>
+    void add(T v){
+        static_assert(std::is_integral_v<T> || std::is_enum_v<T>, "StreamHash takes integers");
+        h_ = mix(h_ + kGolden + static_cast<std::uint64_t>(v));
+    }
+    std::uint64_t value() const{return h_;}
+
+    static std::uint64_t mix(std::uint64_t z){
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    static constexpr std::uint64_t kGolden = 0x9e3779b97f4a7c15ull;
+    std::uint64_t h_{0};
+};
+
+//16 hex digits, for printing and diffing
+inline std::string hex64(std::uint64_t v){
+    static constexpr char kDigits[] = "0123456789abcdef";
+    std::string out(16, '0');
+    for(int i = 15; i >= 0; --i, v >>= 4){out[static_cast<std::size_t>(i)] = kDigits[v & 15];}
+    return out;
+}
+
+//resting orders in priority order (price, then time), bids before asks
+template<typename Book>
+std::uint64_t bookFingerprint(const Book& book){
+    StreamHash h;
+    std::uint64_t orders = 0;
+    book.forEachOrder([&](const Order& o){
+        h.add(o.side);
+        h.add(o.price);
+        h.add(o.id);
+        h.add(o.qty);
+        ++orders;
+    });
+    h.add(orders);
+    return h.value();
+}
+
+//every existing book's state hash (OrderBook::stateHash, kept incrementally)
+//with its SymbolId: equal for two engines that applied the same events (symbols
+//resolved but never used do not count). O(symbols), not O(orders), so a hot
+//standby's primary can take it on the engine thread
+inline std::uint64_t engineStateHash(const MatchingEngine& engine){
+    StreamHash h;
+    for(SymbolId s = 0; s < engine.symbolIndex().size(); ++s){
+        if(const auto* book = engine.findBook(s)){
+            h.add(s);
+            h.add(book->stateHash());
+            h.add(book->nextOrderId());
+        }
+    }
+    return h.value();
+}
+
+//replay fingerprint: the trade sequence (global and per symbol), what every
+//event returned (assigned / cancelled id or 0, so rejects count too) and, at
+//the end, each symbol's resting book. Two builds agree on a log iff their
+//fingerprints match (up to hash collisions); checkpoints narrow down where
+//they first diverge
+class ReplayFingerprint{
+public:
+    void onTrade(const Trade& t){
+        trades_.add(t.symbol_id);
+        trades_.add(t.price);
+        trades_.add(t.qty);
+        trades_.add(t.buy_id);
+        trades_.add(t.sell_id);
+        ++trade_count_;
+        if(t.symbol_id >= symbol_trades_.size()){symbol_trades_.resize(t.symbol_id + 1);}
+        StreamHash& s = symbol_trades_[t.symbol_id];
+        s.add(t.price);
+        s.add(t.qty);
+        s.add(t.buy_id);
+        s.add(t.sell_id);
+    }
+
+    void onEvent(OrderId result){
+        outcomes_.add(result);
+        ++event_count_;
+    }
+
+    //state so far; books are not included (see value())
+    std::uint64_t checkpoint() const{return StreamHash::mix(trades_.value() ^ StreamHash::mix(outcomes_.value()));}
+
+    //trade hash of one symbol (0 if it never traded)
+    std::uint64_t symbolTrades(SymbolId symbol) const{
+        return symbol < symbol_trades_.size() ? symbol_trades_[symbol].value() : 0;
+    }
+
+    //final fingerprint: checkpoint() plus every book, in SymbolId order
+    std::uint64_t value(const MatchingEngine& engine) const{
+        StreamHash h;
+        h.add(checkpoint());
+        for(SymbolId s = 0; s < engine.symbolIndex().size(); ++s){
+            const auto* book = engine.findBook(s);
+            h.add(book ? bookFingerprint(*book) : 0);
+        }
+        return h.value();
+    }
+
+    std::uint64_t events() const{return event_count_;}
+    std::uint64_t trades() const{return trade_count_;}
+
+private:
+    StreamHash trades_;
+    StreamHash outcomes_;
+    std::vector<StreamHash> symbol_trades_;
+    std::uint64_t event_count_{0};
+    std::uint64_t trade_count_{0};
+};
+
+}
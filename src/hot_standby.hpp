@@ -0,0 +1,394 @@
+#pragma once
+
+#include "async_matching_engine.hpp"
+#include "fingerprint.hpp"
+#include "latency_stats.hpp"
+#include "shm_gateway.hpp"
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace matching{
+
+//--- hot standby: the primary's applied events through a shared-memory ring ---
+//
+//Segment layout:
+//  ReplControl: magic, geometry, primary / standby liveness, state-hash slots,
+//               symbol directory
+//  ring:        ReplEntry per applied event, in the order the primary applied them
+//The primary's cost per event is one ring push (plus an engine state hash every
+//hash_every events, O(symbols): books keep theirs up to date). The standby applies the same events to its own
+//MatchingEngine, checks the hashes, and can take over from the last sequence
+//number it applied when the primary stops or dies. Nothing is replayed from
+//disk, so the standby must attach before the ring first fills: once it is full
+//with no live standby draining it, the primary abandons replication
+
+struct ReplEntry{
+    std::uint64_t seq;   //1-based applied-event number; 0: defines SymbolId event.symbol
+    InternalEvent event;
+};
+
+static_assert(std::is_trivially_copyable_v<ReplEntry>, "ReplEntry must be memcpy-able");
+
+enum class ReplState: std::uint32_t {Running, Closed, Abandoned};
+
+//engineStateHash after event seq; seq is written last (0 while being rewritten)
+struct ReplHash{
+    std::atomic<std::uint64_t> seq;
+    std::atomic<std::uint64_t> hash;
+};
+
+struct ReplControl{
+    static constexpr std::uint64_t kMagic = 0x4f425245504c3031ull; //"OBREPL01"
+    static constexpr std::uint32_t kVersion = 1;
+    static constexpr std::uint32_t kMaxSymbols = 4096;
+    static constexpr std::size_t kSymbolChars = 32;
+    static constexpr std::uint32_t kHashSlots = 64;
+
+    std::atomic<std::uint64_t> magic; //written last by the creator
+    std::uint32_t version;
+    std::int32_t primary_pid;
+    std::uint64_t ring_capacity;
+    std::uint64_t hash_every;
+    std::atomic<ReplState> state;
+    std::uint64_t final_seq;  //valid once state is Closed
+    std::uint64_t final_hash;
+
+    alignas(64) std::atomic<std::int64_t> primary_heartbeat_ns; //latencyNowNs() (CLOCK_MONOTONIC, system wide)
+    std::atomic<std::uint64_t> published;
+    alignas(64) std::atomic<std::int32_t> standby_pid;
+    std::atomic<std::int64_t> standby_heartbeat_ns;
+    std::atomic<std::uint64_t> standby_applied;
+
+    ReplHash hashes[kHashSlots];
+    char symbols[kMaxSymbols][kSymbolChars];
+
+    static std::size_t ringOffset(){return (sizeof(ReplControl) + 63) & ~std::size_t{63};}
+    static std::size_t segmentBytes(std::uint64_t capacity){
+        return ringOffset() + ShmRing<ReplEntry>::bytes(capacity);
+    }
+    std::byte* ring(){return reinterpret_cast<std::byte*>(this) + ringOffset();}
+};
+
+//primary side: creates the named segment (replacing a stale one). Hand it to
+//AsyncMatchingEngine::replicateTo before the engine applies anything; stop the
+//engine before destroying it
+class ReplicationPublisher final: public EventReplicator{
+public:
+    explicit ReplicationPublisher(std::string name, std::uint64_t ring_capacity = 1 << 20,
+                                  std::uint64_t hash_every = 1 << 16,
+                                  std::int64_t standby_timeout_ns = 1'000'000'000):
+        name_(std::move(name)), standby_timeout_ns_(standby_timeout_ns){
+        if(ring_capacity == 0 || (ring_capacity & (ring_capacity - 1)) != 0){
+            throw std::invalid_argument("replication: ring capacity must be a power of two");
+        }
+        if(hash_every == 0){throw std::invalid_argument("replication: hash interval");}
+        ::shm_unlink(name_.c_str());
+        const int fd = ::shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if(fd < 0){throw detail::shmError("shm_open", name_);}
+        const std::size_t bytes = ReplControl::segmentBytes(ring_capacity);
+        if(::ftruncate(fd, static_cast<off_t>(bytes)) < 0){
+            ::close(fd);
+            ::shm_unlink(name_.c_str());
+            throw detail::shmError("ftruncate", name_);
+        }
+        map_ = std::make_unique<detail::ShmMapping>(fd, bytes);
+        ::close(fd);
+        if(!map_->ok()){
+            ::shm_unlink(name_.c_str());
+            throw detail::shmError("mmap", name_);
+        }
+
+        ctl_ = new(map_->addr) ReplControl{};
+        ctl_->version = ReplControl::kVersion;
+        ctl_->primary_pid = static_cast<std::int32_t>(::getpid());
+        ctl_->ring_capacity = ring_capacity;
+        ctl_->hash_every = hash_every;
+        ring_ = ShmRing<ReplEntry>(new(ctl_->ring()) ShmRingHeader{}, ring_capacity);
+        ctl_->primary_heartbeat_ns.store(latencyNowNs(), std::memory_order_relaxed);
+        ctl_->magic.store(ReplControl::kMagic, std::memory_order_release);
+    }
+
+    ~ReplicationPublisher() override{::shm_unlink(name_.c_str());}
+
+    ReplicationPublisher(const ReplicationPublisher&) = delete;
+    ReplicationPublisher& operator=(const ReplicationPublisher&) = delete;
+
+    const std::string& name() const{return name_;}
+
+    //monitoring (any thread)
+    std::uint64_t published() const{return ctl_->published.load(std::memory_order_relaxed);}
+    bool abandoned() const{return ctl_->state.load(std::memory_order_acquire) == ReplState::Abandoned;}
+    std::uint64_t stalls() const{return stalls_.load(std::memory_order_relaxed);}
+    std::uint64_t standbyApplied() const{return ctl_->standby_applied.load(std::memory_order_relaxed);}
+
+    //--- EventReplicator (engine thread) ---
+    void replicate(const InternalEvent& e, const MatchingEngine& engine) override{
+        if(!active_){return;}
+        while(defined_ <= e.symbol){
+            const char* name = engine.symbolIndex().nameCStr(defined_);
+            if(defined_ >= ReplControl::kMaxSymbols || std::strlen(name) >= ReplControl::kSymbolChars){
+                abandon();
+                return;
+            }
+            std::strcpy(ctl_->symbols[defined_], name);
+            InternalEvent def{};
+            def.symbol = defined_;
+            if(!push(ReplEntry{0, def})){return;}
+            ++defined_;
+        }
+        if(!push(ReplEntry{seq_ + 1, e})){return;}
+        ctl_->published.store(++seq_, std::memory_order_release);
+        if(seq_ % ctl_->hash_every == 0){publishHash(seq_, engineStateHash(engine));}
+    }
+
+    void idle(const MatchingEngine&) override{
+        ctl_->primary_heartbeat_ns.store(latencyNowNs(), std::memory_order_relaxed);
+    }
+
+    void finish(const MatchingEngine& engine) override{
+        if(!active_){return;}
+        active_ = false;
+        ctl_->final_seq = seq_;
+        ctl_->final_hash = engineStateHash(engine);
+        ctl_->state.store(ReplState::Closed, std::memory_order_release);
+    }
+
+private:
+    std::string name_;
+    std::int64_t standby_timeout_ns_;
+    std::unique_ptr<detail::ShmMapping> map_;
+    ReplControl* ctl_{nullptr};
+    ShmRing<ReplEntry> ring_; //primary: producer view
+    std::uint64_t seq_{0};
+    SymbolId defined_{0};
+    bool active_{true};
+    std::atomic<std::uint64_t> stalls_{0};
+
+    //a full ring waits for a live standby; without one, replication ends here
+    bool push(const ReplEntry& entry){
+        if(ring_.push(entry)){return true;}
+        stalls_.fetch_add(1, std::memory_order_relaxed);
+        do{
+            if(!standbyAlive()){
+                abandon();
+                return false;
+            }
+        }while(!ring_.push(entry));
+        return true;
+    }
+
+    bool standbyAlive() const{
+        const std::int32_t pid = ctl_->standby_pid.load(std::memory_order_acquire);
+        return detail::processAlive(pid) &&
+               latencyNowNs() - ctl_->standby_heartbeat_ns.load(std::memory_order_relaxed) <= standby_timeout_ns_;
+    }
+
+    void abandon(){
+        active_ = false;
+        ctl_->state.store(ReplState::Abandoned, std::memory_order_release);
+    }
+
+    void publishHash(std::uint64_t seq, std::uint64_t hash){
+        ReplHash& slot = ctl_->hashes[(seq / ctl_->hash_every) % ReplControl::kHashSlots];
+        slot.seq.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.hash.store(hash, std::memory_order_relaxed);
+        slot.seq.store(seq, std::memory_order_release);
+    }
+};
+
+//Following: applying the primary's stream. PrimaryClosed: the primary stopped
+//cleanly and the final state hash matched. PrimaryLost: the primary died or its
+//heartbeat went stale; everything it published was applied. Abandoned: the
+//primary gave up on replication, the standby's state is incomplete. Diverged: a
+//state hash did not match
+enum class StandbyState{Following, PrimaryClosed, PrimaryLost, Abandoned, Diverged};
+
+inline const char* standbyStateName(StandbyState s){
+    switch(s){
+        case StandbyState::Following: return "following";
+        case StandbyState::PrimaryClosed: return "primary-closed";
+        case StandbyState::PrimaryLost: return "primary-lost";
+        case StandbyState::Abandoned: return "abandoned";
+        case StandbyState::Diverged: return "diverged";
+    }
+    return "?";
+}
+
+//standby side: opens the segment by name and claims the consumer end. poll()
+//from one thread until state() leaves Following; engine() then holds the book
+//state after applied() events and can serve in the primary's place.
+//primary_timeout_ns 0: only the primary's exit ends following. on_trade sees
+//the replicated trades and, after a takeover, the standby's own
+class HotStandby{
+public:
+    explicit HotStandby(const std::string& name, std::int64_t primary_timeout_ns = 0,
+                        MatchingEngine::TradeCallback on_trade = nullptr):
+        primary_timeout_ns_(primary_timeout_ns), engine_(std::move(on_trade)){
+        const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if(fd < 0){throw detail::shmError("shm_open", name);}
+        struct stat st{};
+        if(::fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < sizeof(ReplControl)){
+            ::close(fd);
+            throw std::runtime_error("shm " + name + ": not a replication segment");
+        }
+        map_ = std::make_unique<detail::ShmMapping>(fd, static_cast<std::size_t>(st.st_size));
+        ::close(fd);
+        if(!map_->ok()){throw detail::shmError("mmap", name);}
+        ctl_ = static_cast<ReplControl*>(map_->addr);
+        if(ctl_->magic.load(std::memory_order_acquire) != ReplControl::kMagic ||
+           ctl_->version != ReplControl::kVersion ||
+           ReplControl::segmentBytes(ctl_->ring_capacity) > map_->bytes){
+            throw std::runtime_error("shm " + name + ": segment not ready or incompatible");
+        }
+        if(ctl_->state.load(std::memory_order_acquire) == ReplState::Abandoned){
+            throw std::runtime_error("shm " + name + ": primary abandoned replication (standby attached too late)");
+        }
+
+        std::int32_t pid = ctl_->standby_pid.load(std::memory_order_acquire);
+        const auto self = static_cast<std::int32_t>(::getpid());
+        if(detail::processAlive(pid) ||
+           !ctl_->standby_pid.compare_exchange_strong(pid, self, std::memory_order_acq_rel)){
+            throw std::runtime_error("shm " + name + ": another standby is attached");
+        }
+        //a standby before us consumed entries this engine would be missing
+        if(reinterpret_cast<ShmRingHeader*>(ctl_->ring())->tail.load(std::memory_order_acquire) != 0){
+            ctl_->standby_pid.store(0, std::memory_order_release);
+            throw std::runtime_error("shm " + name + ": stream already consumed, restart the primary");
+        }
+        ctl_->standby_heartbeat_ns.store(latencyNowNs(), std::memory_order_relaxed);
+        ring_ = ShmRing<ReplEntry>(ctl_->ring(), ctl_->ring_capacity);
+        caught_up_ns_ = latencyNowNs();
+    }
+
+    ~HotStandby(){ctl_->standby_pid.store(0, std::memory_order_release);}
+
+    HotStandby(const HotStandby&) = delete;
+    HotStandby& operator=(const HotStandby&) = delete;
+
+    //applies up to max entries; returns the events applied. Once the ring is
+    //empty it checks whether the primary is still there
+    std::size_t poll(std::size_t max = 4096){
+        if(state_ != StandbyState::Following){return 0;}
+        std::size_t n = 0;
+        ReplEntry entry{};
+        while(n < max && ring_.pop(entry)){n += apply(entry);}
+        const std::int64_t now = latencyNowNs();
+        ctl_->standby_applied.store(applied_, std::memory_order_relaxed);
+        ctl_->standby_heartbeat_ns.store(now, std::memory_order_relaxed);
+        checkHashes();
+        if(n < max && state_ == StandbyState::Following){
+            caught_up_ns_ = now;
+            checkPrimary(now);
+        }
+        return n;
+    }
+
+    StandbyState state() const{return state_;}
+    std::uint64_t applied() const{return applied_;}
+    //events the primary published that are not applied yet
+    std::uint64_t lag() const{return ctl_->published.load(std::memory_order_acquire) - applied_;}
+    //time since the standby last drained the ring
+    std::int64_t lagNs() const{return lag() == 0 ? 0 : latencyNowNs() - caught_up_ns_;}
+    std::uint64_t hashesVerified() const{return verified_;}
+    std::uint64_t hashesMissed() const{return missed_;} //overwritten before the standby got there
+    std::int32_t primaryPid() const{return ctl_->primary_pid;}
+
+    MatchingEngine& engine(){return engine_;}
+    const MatchingEngine& engine() const{return engine_;}
+
+private:
+    struct PendingHash{
+        std::uint64_t seq;
+        std::uint64_t hash;
+    };
+
+    std::int64_t primary_timeout_ns_;
+    std::unique_ptr<detail::ShmMapping> map_;
+    ReplControl* ctl_{nullptr};
+    ShmRing<ReplEntry> ring_; //standby: consumer view
+    MatchingEngine engine_;
+    StandbyState state_{StandbyState::Following};
+    std::uint64_t applied_{0};
+    std::int64_t caught_up_ns_{0};
+    std::deque<PendingHash> pending_;
+    std::uint64_t verified_{0};
+    std::uint64_t missed_{0};
+
+    //returns 1 for an event, 0 for a symbol definition
+    std::size_t apply(const ReplEntry& entry){
+        if(entry.seq == 0){
+            const char* name = ctl_->symbols[entry.event.symbol];
+            engine_.resolveSymbol(std::string(name, ::strnlen(name, ReplControl::kSymbolChars)));
+            return 0;
+        }
+        engine_.processInternal(entry.event);
+        applied_ = entry.seq;
+        if(applied_ % ctl_->hash_every == 0){pending_.push_back({applied_, engineStateHash(engine_)});}
+        return 1;
+    }
+
+    //compares local hashes with what the primary published for the same seq;
+    //a hash not published yet stays pending
+    void checkHashes(){
+        while(!pending_.empty()){
+            const PendingHash& p = pending_.front();
+            const ReplHash& slot = ctl_->hashes[(p.seq / ctl_->hash_every) % ReplControl::kHashSlots];
+            const std::uint64_t s1 = slot.seq.load(std::memory_order_acquire);
+            const std::uint64_t h = slot.hash.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const std::uint64_t s2 = slot.seq.load(std::memory_order_relaxed);
+            if(s1 != s2 || s1 < p.seq){
+                if(pending_.size() <= ReplControl::kHashSlots){return;}
+                ++missed_;
+            }
+            else if(s1 > p.seq){++missed_;}
+            else if(h != p.hash){
+                state_ = StandbyState::Diverged;
+                return;
+            }
+            else{++verified_;}
+            pending_.pop_front();
+        }
+    }
+
+    //ring drained: has the primary closed, abandoned us, died or hung?
+    void checkPrimary(std::int64_t now){
+        const ReplState st = ctl_->state.load(std::memory_order_acquire);
+        if(st == ReplState::Closed){
+            if(applied_ < ctl_->final_seq){return;}
+            state_ = engineStateHash(engine_) == ctl_->final_hash ? StandbyState::PrimaryClosed : StandbyState::Diverged;
+            if(state_ == StandbyState::PrimaryClosed){++verified_;}
+        }
+        else if(st == ReplState::Abandoned){
+            state_ = StandbyState::Abandoned;
+        }
+        else if(!detail::processAlive(ctl_->primary_pid) ||
+                (primary_timeout_ns_ > 0 &&
+                 now - ctl_->primary_heartbeat_ns.load(std::memory_order_relaxed) > primary_timeout_ns_)){
+            //entries pushed after the ring looked empty: the next poll drains them
+            ReplEntry entry{};
+            if(ring_.pop(entry)){
+                apply(entry);
+                return;
+            }
+            state_ = StandbyState::PrimaryLost;
+        }
+    }
+};
+
+}
+
+#endif
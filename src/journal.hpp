@@ -0,0 +1,750 @@
+#pragma once
+
+#include "matching_engine.hpp"
+#include "log_writer.hpp"
+#include "protocol.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace matching{
+
+//in-memory event sequence plus the symbol table its SymbolIds refer to
+struct EventTape{
+    std::vector<std::string> symbols; //SymbolId → name
+    std::vector<InternalEvent> events;
+    std::vector<std::int64_t> timestamps; //ns per event; empty when the source had none
+    //id the recording engine assigned per event (0: none or rejected); empty
+    //when the source did not record acks
+    std::vector<OrderId> assigned;
+};
+
+//event types that take a fresh order id (an amend may keep its target's)
+inline bool assignsId(EventType t){
+    return t == EventType::NewLimit || t == EventType::NewMarket || t == EventType::Replace ||
+           t == EventType::Amend;
+}
+
+//binary journal layout (native endianness):
+//  header: "MJNL", u32 version
+//version 1, raw:
+//  frames: 'S' u32 symbol_id, u16 len, name[len]   symbol definition, before first use
+//          'E' InternalEvent                      raw record
+//          'A' OrderId                            id assigned to the preceding record
+//version 2, compact: see CompactJournalWriter
+inline constexpr char kJournalMagic[4] = {'M', 'J', 'N', 'L'};
+inline constexpr std::uint32_t kJournalVersion = 1;
+inline constexpr std::uint32_t kCompactJournalVersion = 2;
+//symbol ids past this are corrupt; readers size tables by id
+inline constexpr SymbolId kMaxJournalSymbols = 1u << 20;
+
+//records go through LogWriter (io_uring where available); appending never
+//waits for the disk unless every buffer is still being written
+class JournalWriter{
+public:
+    bool open(const std::string& path, const LogWriterOptions& options = {}){
+        if(!out_.open(path, options)){return false;}
+        out_.append(kJournalMagic, sizeof(kJournalMagic));
+        writePod(kJournalVersion);
+        defined_.clear();
+        return true;
+    }
+
+    //emits the symbol definition the first time a SymbolId is seen
+    void append(const InternalEvent& e, const std::string& name){
+        if(e.symbol >= defined_.size()){defined_.resize(e.symbol + 1, 0);}
+        if(!defined_[e.symbol]){
+            writePod('S');
+            writePod(e.symbol);
+            writePod(static_cast<std::uint16_t>(name.size()));
+            out_.append(name);
+            defined_[e.symbol] = 1;
+        }
+        writePod('E');
+        writePod(e);
+    }
+
+    //the id the engine assigned to the record just appended (assignsId types)
+    void appendAssigned(OrderId id){
+        writePod('A');
+        writePod(id);
+    }
+
+    void flush(){out_.flush();}
+
+    //waits for every record to reach the file; false if a write failed
+    bool close(){
+        out_.close();
+        return out_.error() == 0;
+    }
+
+    const LogWriter& writer() const{return out_;}
+
+private:
+    LogWriter out_;
+    std::vector<std::uint8_t> defined_;
+
+    template<typename T>
+    void writePod(const T& v){out_.appendPod(v);}
+};
+
+//--- compact journal (version 2) ---
+//
+//After the file header come self-contained blocks of about kCompactBlockBytes:
+//  CompactBlockHeader, then event_count encoded events
+//and, once the writer is closed, a footer for random access:
+//  symbol table: u32 count, then (u32 id, u16 len, name[len]) each
+//  block index:  CompactBlockIndex per block
+//  symbol index: u32 count, then (u32 id, u32 n, u32 block[n]) each: the blocks
+//                holding the symbol's events (absent in older journals)
+//  CompactTrailer (last 24 bytes of the file)
+//A journal cut short (no trailer) is still readable front to back.
+//
+//Event encoding: one tag byte, then LEB128 varints (signed values zigzagged)
+//  tag:  bits 0-2 EventType (7 = symbol definition), bit 3 sell, bits 4-5 tif,
+//        bit 6 same symbol as the previous event, bit 7 id present
+//  [symbol]   unless bit 6
+//  ts         delta to the previous event's timestamp
+//  [id]       if bit 7: delta to the previous id present
+//  price      NewLimit/Replace/Amend: delta to the symbol's previous such price,
+//             other types: the value itself (normally 0)
+//  qty
+//  user       delta to the previous event's user
+//  [assigned] blocks flagged kCompactBlockAssignedIds, assignsId types only:
+//             0 if the engine assigned none, else 1 + delta to the previous one
+//  symbol definition: tag 7, symbol, len, name[len]; before the symbol's first use
+//All deltas restart from 0 at each block, so any block decodes on its own.
+//A limit order costs about 5-7 bytes against 49 for a raw version-1 frame
+
+inline constexpr std::size_t kCompactBlockBytes = 64 << 10;
+inline constexpr char kCompactBlockMagic[4] = {'M', 'J', 'B', 'K'};
+inline constexpr char kCompactTrailerMagic[4] = {'M', 'J', 'I', 'X'};
+inline constexpr std::uint32_t kCompactBlockAssignedIds = 1; //CompactBlockHeader::flags
+
+struct CompactBlockHeader{
+    char magic[4];
+    std::uint32_t payload_bytes;
+    std::uint32_t event_count;
+    std::uint32_t flags;
+    std::uint64_t first_event; //index of the block's first event in the journal
+};
+
+struct CompactBlockIndex{
+    std::uint64_t offset; //file offset of the block header
+    std::uint64_t first_event;
+    std::uint32_t event_count;
+    std::uint32_t payload_bytes;
+};
+
+struct CompactTrailer{
+    std::uint64_t index_offset; //file offset of the symbol table
+    std::uint64_t block_count;
+    char magic[4];
+    std::uint32_t symbol_count;
+};
+
+static_assert(sizeof(CompactBlockHeader) == 24 && sizeof(CompactBlockIndex) == 24 &&
+              sizeof(CompactTrailer) == 24, "compact journal layout");
+
+namespace detail{
+
+inline constexpr std::uint8_t kTagSymbolDef = 7;
+inline constexpr std::uint8_t kTagSell = 1u << 3;
+inline constexpr std::uint8_t kTagSameSymbol = 1u << 6;
+inline constexpr std::uint8_t kTagHasId = 1u << 7;
+
+inline std::uint64_t zigzag(std::int64_t v){
+    return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63);
+}
+inline std::int64_t unzigzag(std::uint64_t v){
+    return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+inline void putVarint(std::vector<std::uint8_t>& out, std::uint64_t v){
+    while(v >= 0x80){
+        out.push_back(static_cast<std::uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(v));
+}
+
+//a varint is at most kMaxVarintBytes long; an event is a tag byte and at most
+//7 varints (symbol, ts, id, price, qty, user, assigned id)
+inline constexpr std::size_t kMaxVarintBytes = 10;
+inline constexpr std::size_t kMaxEventBytes = 1 + 7 * kMaxVarintBytes;
+
+//unchecked: the decoder only starts an event inside the payload, and the buffer
+//carries at least kMaxEventBytes of zeroes after it, so even a corrupt event
+//ends (a zero byte ends a varint) before reading past the buffer
+inline std::uint64_t getVarint(const std::uint8_t*& p){
+    std::uint64_t v = *p & 0x7f;
+    unsigned shift = 7;
+    while((*p++ & 0x80) && shift < 64){
+        v |= static_cast<std::uint64_t>(*p & 0x7f) << shift;
+        shift += 7;
+    }
+    return v;
+}
+
+inline bool hasPrice(EventType t){
+    return t == EventType::NewLimit || t == EventType::Replace || t == EventType::Amend;
+}
+
+//previous price per symbol, invalidated lazily when a new block starts
+class BlockPrices{
+public:
+    void reset(){++epoch_;}
+    Price get(SymbolId s) const{
+        return s < prices_.size() && prices_[s].epoch == epoch_ ? prices_[s].price : 0;
+    }
+    void set(SymbolId s, Price p){
+        if(s >= prices_.size()){prices_.resize(s + 1);}
+        prices_[s] = Entry{p, epoch_};
+    }
+private:
+    struct Entry{Price price; std::uint64_t epoch;};
+    std::vector<Entry> prices_;
+    std::uint64_t epoch_{1};
+};
+
+//per-block delta state shared by encoder and decoder
+struct BlockState{
+    SymbolId symbol{0};
+    bool has_symbol{false};
+    std::int64_t ts{0};
+    OrderId id{0};
+    OrderId assigned{0};
+    UserId user{0};
+    BlockPrices prices;
+
+    void reset(){
+        has_symbol = false;
+        ts = 0;
+        id = 0;
+        assigned = 0;
+        user = 0;
+        prices.reset();
+    }
+};
+
+}
+
+//writes version-2 journals through LogWriter; close() adds the footer
+class CompactJournalWriter{
+public:
+    ~CompactJournalWriter(){close();}
+
+    //assigned_ids: every append carries the id the engine assigned
+    bool open(const std::string& path, const LogWriterOptions& options = {}, bool assigned_ids = false){
+        if(!out_.open(path, options)){return false;}
+        out_.append(kJournalMagic, sizeof(kJournalMagic));
+        out_.appendPod(kCompactJournalVersion);
+        assigned_ids_ = assigned_ids;
+        payload_.clear();
+        payload_.reserve(kCompactBlockBytes + 1024);
+        symbols_.clear();
+        symbol_blocks_.clear();
+        index_.clear();
+        state_.reset();
+        block_events_ = 0;
+        events_ = 0;
+        open_ = true;
+        return true;
+    }
+
+    //timestamp_ns: original arrival time, 0 when unknown; assigned: the engine's
+    //answer, kept only when the journal was opened with assigned_ids
+    void append(const InternalEvent& e, const std::string& name, std::int64_t timestamp_ns = 0,
+                OrderId assigned = 0){
+        using namespace detail;
+        if(e.symbol >= symbols_.size() || !symbols_[e.symbol]){defineSymbol(e.symbol, name);}
+        auto& blocks = symbol_blocks_[e.symbol];
+        const auto block = static_cast<std::uint32_t>(index_.size());
+        if(blocks.empty() || blocks.back() != block){blocks.push_back(block);}
+
+        std::uint8_t tag = static_cast<std::uint8_t>(e.type) |
+                           (e.side == Side::Sell ? kTagSell : 0) |
+                           static_cast<std::uint8_t>(static_cast<std::uint8_t>(e.tif) << 4);
+        const bool same_symbol = state_.has_symbol && state_.symbol == e.symbol;
+        if(same_symbol){tag |= kTagSameSymbol;}
+        if(e.id != 0){tag |= kTagHasId;}
+        payload_.push_back(tag);
+        if(!same_symbol){putVarint(payload_, e.symbol);}
+        putVarint(payload_, zigzag(timestamp_ns - state_.ts));
+        if(e.id != 0){
+            putVarint(payload_, zigzag(e.id - state_.id));
+            state_.id = e.id;
+        }
+        if(hasPrice(e.type)){
+            putVarint(payload_, zigzag(e.price - state_.prices.get(e.symbol)));
+            state_.prices.set(e.symbol, e.price);
+        }
+        else{putVarint(payload_, zigzag(e.price));}
+        putVarint(payload_, zigzag(e.qty));
+        putVarint(payload_, zigzag(static_cast<std::int64_t>(e.user_id) - static_cast<std::int64_t>(state_.user)));
+        if(assigned_ids_ && assignsId(e.type)){
+            putVarint(payload_, assigned == 0 ? 0 : zigzag(assigned - state_.assigned) + 1);
+            if(assigned != 0){state_.assigned = assigned;}
+        }
+        state_.symbol = e.symbol;
+        state_.has_symbol = true;
+        state_.ts = timestamp_ns;
+        state_.user = e.user_id;
+        ++block_events_;
+        if(payload_.size() >= kCompactBlockBytes){endBlock();}
+    }
+
+    //finishes the last block and writes the footer; false if a write failed
+    bool close(){
+        if(!open_){return true;}
+        open_ = false;
+        endBlock();
+        CompactTrailer trailer{};
+        trailer.index_offset = out_.bytesAppended();
+        trailer.block_count = index_.size();
+        std::memcpy(trailer.magic, kCompactTrailerMagic, sizeof(trailer.magic));
+        std::uint32_t defined = 0;
+        for(std::uint8_t d: symbols_){defined += d;}
+        trailer.symbol_count = defined;
+        out_.appendPod(defined);
+        for(SymbolId id = 0; id < symbols_.size(); ++id){
+            if(!symbols_[id]){continue;}
+            out_.appendPod(id);
+            out_.appendPod(static_cast<std::uint16_t>(names_[id].size()));
+            out_.append(names_[id]);
+        }
+        for(const auto& b: index_){out_.appendPod(b);}
+        out_.appendPod(defined);
+        for(SymbolId id = 0; id < symbols_.size(); ++id){
+            if(!symbols_[id]){continue;}
+            out_.appendPod(id);
+            out_.appendPod(static_cast<std::uint32_t>(symbol_blocks_[id].size()));
+            out_.append(symbol_blocks_[id].data(), symbol_blocks_[id].size() * sizeof(std::uint32_t));
+        }
+        out_.appendPod(trailer);
+        out_.close();
+        return out_.error() == 0;
+    }
+
+    std::uint64_t events() const{return events_;}
+    std::uint64_t bytes() const{return out_.bytesAppended();}
+
+private:
+    LogWriter out_;
+    std::vector<std::uint8_t> payload_;
+    std::vector<std::uint8_t> symbols_; //defined flag per SymbolId
+    std::vector<std::string> names_;
+    std::vector<std::vector<std::uint32_t>> symbol_blocks_; //per SymbolId, ascending
+    std::vector<CompactBlockIndex> index_;
+    detail::BlockState state_;
+    std::uint32_t block_events_{0};
+    std::uint64_t events_{0};
+    bool open_{false};
+    bool assigned_ids_{false};
+
+    void defineSymbol(SymbolId id, const std::string& name){
+        if(id >= symbols_.size()){
+            symbols_.resize(id + 1, 0);
+            names_.resize(id + 1);
+            symbol_blocks_.resize(id + 1);
+        }
+        symbols_[id] = 1;
+        names_[id] = name;
+        payload_.push_back(detail::kTagSymbolDef);
+        detail::putVarint(payload_, id);
+        detail::putVarint(payload_, name.size());
+        payload_.insert(payload_.end(), name.begin(), name.end());
+    }
+
+    void endBlock(){
+        if(payload_.empty()){return;}
+        CompactBlockHeader h{};
+        std::memcpy(h.magic, kCompactBlockMagic, sizeof(h.magic));
+        h.payload_bytes = static_cast<std::uint32_t>(payload_.size());
+        h.event_count = block_events_;
+        h.flags = assigned_ids_ ? kCompactBlockAssignedIds : 0;
+        h.first_event = events_;
+        index_.push_back(CompactBlockIndex{out_.bytesAppended(), events_, block_events_, h.payload_bytes});
+        out_.appendPod(h);
+        out_.append(payload_.data(), payload_.size());
+        events_ += block_events_;
+        block_events_ = 0;
+        payload_.clear();
+        state_.reset();
+    }
+};
+
+//random access over a version-2 journal: blocks are located through the footer
+//(or by walking block headers when the journal was not closed) and decoded one
+//at a time
+class CompactJournalReader{
+public:
+    bool open(const std::string& path){
+        in_.open(path, std::ios::binary);
+        if(!in_){return false;}
+        char magic[sizeof(kJournalMagic)] = {};
+        std::uint32_t version = 0;
+        in_.read(magic, sizeof(magic));
+        in_.read(reinterpret_cast<char*>(&version), sizeof(version));
+        if(!in_ || std::memcmp(magic, kJournalMagic, sizeof(magic)) != 0 || version != kCompactJournalVersion){
+            return false;
+        }
+        symbols_.clear();
+        index_.clear();
+        symbol_blocks_.clear();
+        return readFooter() || scanBlocks();
+    }
+
+    std::size_t blockCount() const{return index_.size();}
+    const CompactBlockIndex& block(std::size_t i) const{return index_[i];}
+    std::uint64_t eventCount() const{
+        return index_.empty() ? 0 : index_.back().first_event + index_.back().event_count;
+    }
+    //complete after open() for a closed journal, else grows as blocks are decoded
+    const std::vector<std::string>& symbols() const{return symbols_;}
+
+    //blocks holding the symbol's events, ascending; nullptr when the journal
+    //has no symbol index (older or not closed): every block may hold them
+    const std::vector<std::uint32_t>* symbolBlocks(SymbolId symbol) const{
+        if(symbol_blocks_.empty()){return nullptr;}
+        static const std::vector<std::uint32_t> kNone;
+        return symbol < symbol_blocks_.size() ? &symbol_blocks_[symbol] : &kNone;
+    }
+
+    //block holding event number n (n < eventCount())
+    std::size_t blockOf(std::uint64_t n) const{
+        auto it = std::upper_bound(index_.begin(), index_.end(), n,
+                                   [](std::uint64_t v, const CompactBlockIndex& b){return v < b.first_event;});
+        return static_cast<std::size_t>(it - index_.begin()) - 1;
+    }
+
+    //appends block i's events (and timestamps / assigned ids when the vectors are
+    //given; assigned gets one entry per event, 0 for events that take no id, and
+    //only if the block recorded them: see blockHasAssigned)
+    bool readBlock(std::size_t i, std::vector<InternalEvent>& events, std::vector<std::int64_t>* timestamps = nullptr,
+                   std::vector<OrderId>* assigned = nullptr){
+        const CompactBlockIndex& b = index_[i];
+        buf_.resize(sizeof(CompactBlockHeader) + b.payload_bytes + kSlack);
+        in_.clear();
+        in_.seekg(static_cast<std::streamoff>(b.offset));
+        if(!in_.read(reinterpret_cast<char*>(buf_.data()), sizeof(CompactBlockHeader) + b.payload_bytes)){
+            return false;
+        }
+        CompactBlockHeader h{};
+        std::memcpy(&h, buf_.data(), sizeof(h));
+        last_flags_ = h.flags;
+        std::uint8_t* payload = buf_.data() + sizeof(CompactBlockHeader);
+        std::memset(payload + b.payload_bytes, 0, kSlack);
+        return decode(payload, b.payload_bytes, b.event_count, h.flags, events, timestamps,
+                      h.flags & kCompactBlockAssignedIds ? assigned : nullptr);
+    }
+
+    //whether the block read last carried assigned ids
+    bool blockHasAssigned() const{return last_flags_ & kCompactBlockAssignedIds;}
+
+    bool readAll(EventTape& out){
+        out.events.reserve(out.events.size() + eventCount());
+        std::vector<std::int64_t> ts;
+        std::vector<OrderId> assigned;
+        ts.reserve(eventCount());
+        bool all_assigned = true;
+        for(std::size_t i = 0; i < index_.size(); ++i){
+            if(!readBlock(i, out.events, &ts, &assigned)){return false;}
+            all_assigned = all_assigned && blockHasAssigned();
+        }
+        out.symbols = symbols_;
+        const bool timed = std::any_of(ts.begin(), ts.end(), [](std::int64_t t){return t != 0;});
+        if(timed){out.timestamps = std::move(ts);}
+        if(all_assigned && !index_.empty()){out.assigned = std::move(assigned);}
+        return true;
+    }
+
+private:
+    //zeroed tail so a truncated event cannot run past the buffer (see getVarint)
+    static constexpr std::size_t kSlack = 80;
+    static_assert(kSlack >= detail::kMaxEventBytes);
+
+    std::ifstream in_;
+    std::vector<std::string> symbols_;
+    std::vector<CompactBlockIndex> index_;
+    std::vector<std::vector<std::uint32_t>> symbol_blocks_;
+    std::vector<std::uint8_t> buf_;
+    detail::BlockState state_;
+    std::uint32_t last_flags_{0};
+
+    bool readFooter(){
+        in_.clear();
+        in_.seekg(0, std::ios::end);
+        const auto size = static_cast<std::uint64_t>(in_.tellg());
+        if(size < 8 + sizeof(CompactTrailer)){return false;}
+        CompactTrailer t{};
+        in_.seekg(static_cast<std::streamoff>(size - sizeof(t)));
+        if(!in_.read(reinterpret_cast<char*>(&t), sizeof(t)) ||
+           std::memcmp(t.magic, kCompactTrailerMagic, sizeof(t.magic)) != 0 || t.index_offset >= size ||
+           t.block_count > (size - t.index_offset) / sizeof(CompactBlockIndex)){
+            return false;
+        }
+        in_.seekg(static_cast<std::streamoff>(t.index_offset));
+        std::uint32_t count = 0;
+        in_.read(reinterpret_cast<char*>(&count), sizeof(count));
+        for(std::uint32_t i = 0; i < count && in_; ++i){
+            SymbolId id = 0;
+            std::uint16_t len = 0;
+            in_.read(reinterpret_cast<char*>(&id), sizeof(id));
+            in_.read(reinterpret_cast<char*>(&len), sizeof(len));
+            std::string name(len, '\0');
+            if(!in_.read(name.data(), len) || id >= kMaxJournalSymbols){
+                symbols_.clear();
+                return false;
+            }
+            if(id >= symbols_.size()){symbols_.resize(id + 1);}
+            symbols_[id] = std::move(name);
+        }
+        index_.resize(t.block_count);
+        in_.read(reinterpret_cast<char*>(index_.data()),
+                 static_cast<std::streamsize>(index_.size() * sizeof(CompactBlockIndex)));
+        //every block must lie before the footer
+        const bool blocks_ok = std::all_of(index_.begin(), index_.end(), [&](const CompactBlockIndex& b){
+            return b.offset <= t.index_offset &&
+                   sizeof(CompactBlockHeader) + std::uint64_t{b.payload_bytes} <= t.index_offset - b.offset;
+        });
+        if(!in_ || !blocks_ok){
+            symbols_.clear();
+            index_.clear();
+            return false;
+        }
+        if(static_cast<std::uint64_t>(in_.tellg()) + sizeof(t) < size){readSymbolIndex();}
+        return true;
+    }
+
+    //optional section; a damaged one is ignored (queries fall back to all blocks)
+    void readSymbolIndex(){
+        std::uint32_t count = 0;
+        in_.read(reinterpret_cast<char*>(&count), sizeof(count));
+        std::vector<std::vector<std::uint32_t>> blocks(symbols_.size());
+        for(std::uint32_t i = 0; i < count && in_; ++i){
+            SymbolId id = 0;
+            std::uint32_t n = 0;
+            in_.read(reinterpret_cast<char*>(&id), sizeof(id));
+            in_.read(reinterpret_cast<char*>(&n), sizeof(n));
+            if(!in_ || id >= blocks.size() || n > index_.size()){return;}
+            blocks[id].resize(n);
+            in_.read(reinterpret_cast<char*>(blocks[id].data()), static_cast<std::streamsize>(n * sizeof(std::uint32_t)));
+        }
+        if(in_){symbol_blocks_ = std::move(blocks);}
+    }
+
+    bool scanBlocks(){
+        in_.clear();
+        std::uint64_t offset = sizeof(kJournalMagic) + sizeof(std::uint32_t);
+        CompactBlockHeader h{};
+        in_.seekg(static_cast<std::streamoff>(offset));
+        while(in_.read(reinterpret_cast<char*>(&h), sizeof(h)) &&
+              std::memcmp(h.magic, kCompactBlockMagic, sizeof(h.magic)) == 0){
+            index_.push_back(CompactBlockIndex{offset, h.first_event, h.event_count, h.payload_bytes});
+            offset += sizeof(h) + h.payload_bytes;
+            in_.seekg(static_cast<std::streamoff>(offset));
+        }
+        //a partly written last block is dropped
+        in_.clear();
+        in_.seekg(0, std::ios::end);
+        const auto size = static_cast<std::uint64_t>(in_.tellg());
+        if(!index_.empty() && index_.back().offset + sizeof(h) + index_.back().payload_bytes > size){
+            index_.pop_back();
+        }
+        return true;
+    }
+
+    bool decode(const std::uint8_t* p, std::size_t bytes, std::uint32_t count, std::uint32_t flags,
+                std::vector<InternalEvent>& events, std::vector<std::int64_t>* timestamps,
+                std::vector<OrderId>* assigned){
+        using namespace detail;
+        const std::uint8_t* const end = p + bytes;
+        state_.reset();
+        std::uint32_t decoded = 0;
+        while(p < end){
+            const std::uint8_t tag = *p++;
+            const std::uint8_t type = tag & 7u;
+            if(type == kTagSymbolDef){
+                const auto id = static_cast<SymbolId>(getVarint(p));
+                const auto len = static_cast<std::size_t>(getVarint(p));
+                if(p + len > end || id >= kMaxJournalSymbols){return false;}
+                if(id >= symbols_.size()){symbols_.resize(id + 1);}
+                symbols_[id].assign(reinterpret_cast<const char*>(p), len);
+                p += len;
+                continue;
+            }
+            InternalEvent e{};
+            e.type = static_cast<EventType>(type);
+            e.side = tag & kTagSell ? Side::Sell : Side::Buy;
+            e.tif = static_cast<TimeInForce>((tag >> 4) & 3u);
+            e.symbol = tag & kTagSameSymbol ? state_.symbol : static_cast<SymbolId>(getVarint(p));
+            if(e.symbol >= kMaxJournalSymbols){return false;}
+            state_.ts += unzigzag(getVarint(p));
+            if(tag & kTagHasId){
+                state_.id += unzigzag(getVarint(p));
+                e.id = state_.id;
+            }
+            if(hasPrice(e.type)){
+                e.price = state_.prices.get(e.symbol) + unzigzag(getVarint(p));
+                state_.prices.set(e.symbol, e.price);
+            }
+            else{e.price = unzigzag(getVarint(p));}
+            e.qty = unzigzag(getVarint(p));
+            state_.user = static_cast<UserId>(static_cast<std::int64_t>(state_.user) + unzigzag(getVarint(p)));
+            e.user_id = state_.user;
+            OrderId id = 0;
+            if((flags & kCompactBlockAssignedIds) && assignsId(e.type)){
+                const std::uint64_t v = getVarint(p);
+                if(v != 0){
+                    state_.assigned += unzigzag(v - 1);
+                    id = state_.assigned;
+                }
+            }
+            state_.symbol = e.symbol;
+            events.push_back(e);
+            if(timestamps){timestamps->push_back(state_.ts);}
+            if(assigned){assigned->push_back(id);}
+            ++decoded;
+        }
+        return p == end && decoded == count;
+    }
+};
+
+//read a binary journal (after the magic) into a tape
+inline bool readJournal(std::istream& in, EventTape& out){
+    std::uint32_t version = 0;
+    if(!in.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != kJournalVersion){
+        std::cerr << "Unsupported journal version: " << version << "\n";
+        return false;
+    }
+    char kind = 0;
+    std::size_t acks = 0;
+    std::size_t expected = 0; //assignsId events
+    while(in.get(kind)){
+        if(kind == 'E'){
+            InternalEvent e{};
+            if(!in.read(reinterpret_cast<char*>(&e), sizeof(e))){break;}
+            out.events.push_back(e);
+            out.assigned.push_back(0);
+            expected += assignsId(e.type);
+        }
+        else if(kind == 'A'){
+            OrderId id = 0;
+            if(!in.read(reinterpret_cast<char*>(&id), sizeof(id))){break;}
+            if(!out.assigned.empty()){out.assigned.back() = id;}
+            ++acks;
+        }
+        else if(kind == 'S'){
+            SymbolId id = 0;
+            std::uint16_t len = 0;
+            if(!in.read(reinterpret_cast<char*>(&id), sizeof(id)) || !in.read(reinterpret_cast<char*>(&len), sizeof(len))){
+                break;
+            }
+            std::string name(len, '\0');
+            if(!in.read(name.data(), len)){break;}
+            if(id >= kMaxJournalSymbols){
+                std::cerr << "Corrupt journal symbol id: " << id << "\n";
+                return false;
+            }
+            if(id >= out.symbols.size()){out.symbols.resize(id + 1);}
+            out.symbols[id] = std::move(name);
+        }
+        else{
+            std::cerr << "Corrupt journal frame: " << static_cast<int>(kind) << "\n";
+            return false;
+        }
+    }
+    if(acks < expected){out.assigned.clear();} //not recorded (or only partly): ids are inferred
+    return true;
+}
+
+//parse a text event log (events.log); non-order lines (D/U/q) are skipped
+inline bool readEventLog(std::istream& in, EventTape& out){
+    SymbolIndex symbols;
+    for(const auto& name: out.symbols){symbols.getOrCreate(name);}
+
+    std::string line;
+    std::size_t acks = 0;
+    std::size_t expected = 0; //assignsId events
+    while(std::getline(in, line)){
+        std::string trimmed = trim(line);
+        OrderId ack = 0;
+        if(parseAckLine(trimmed, ack)){
+            if(!out.assigned.empty()){out.assigned.back() = ack;}
+            ++acks;
+            continue;
+        }
+        if(trimmed.empty() || trimmed[0] == 'D' || trimmed[0] == 'U' ||
+           trimmed[0] == 'q' || trimmed[0] == 'Q'){continue;}
+        Event e{};
+        if(!parseLine(trimmed, e)){continue;}
+
+        InternalEvent ie{};
+        ie.symbol = symbols.getOrCreate(e.symbol);
+        ie.type = e.type;
+        ie.side = e.side;
+        ie.price = e.price;
+        ie.qty = e.qty;
+        ie.id = e.id;
+        ie.tif = e.tif;
+        ie.user_id = e.user_id;
+        out.events.push_back(ie);
+        out.assigned.push_back(0);
+        expected += assignsId(ie.type);
+    }
+    if(acks < expected){out.assigned.clear();}
+    for(std::size_t i = out.symbols.size(); i < symbols.size(); ++i){
+        out.symbols.push_back(symbols.name(static_cast<SymbolId>(i)));
+    }
+    return true;
+}
+
+namespace detail{
+
+inline bool readEventFile(const std::string& path, EventTape& out){
+    std::ifstream in(path, std::ios::binary);
+    if(!in){
+        std::cerr << "ERROR: cannot open event file: " << path << "\n";
+        return false;
+    }
+    char magic[sizeof(kJournalMagic)] = {};
+    if(in.read(magic, sizeof(magic)) && std::memcmp(magic, kJournalMagic, sizeof(magic)) == 0){
+        std::uint32_t version = 0;
+        in.read(reinterpret_cast<char*>(&version), sizeof(version));
+        if(version == kCompactJournalVersion){
+            CompactJournalReader reader;
+            if(!reader.open(path) || !reader.readAll(out)){
+                std::cerr << "Corrupt compact journal: " << path << "\n";
+                return false;
+            }
+            return true;
+        }
+        in.seekg(sizeof(kJournalMagic));
+        return readJournal(in, out);
+    }
+    in.clear();
+    in.seekg(0);
+    return readEventLog(in, out);
+}
+
+}
+
+//load either format: binary journal if the file starts with the magic, else
+//text. Every event's symbol must be defined, so consumers can index per-symbol
+//tables by it
+inline bool loadEventTape(const std::string& path, EventTape& out){
+    if(!detail::readEventFile(path, out)){return false;}
+    const std::size_t n = out.symbols.size();
+    if(std::any_of(out.events.begin(), out.events.end(), [n](const InternalEvent& e){return e.symbol >= n;})){
+        std::cerr << "Corrupt journal: event for an undefined symbol: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+}
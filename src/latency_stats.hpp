@@ -0,0 +1,165 @@
+#pragma once
+
+#include "orderbook.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+
+namespace matching{
+
+inline std::int64_t latencyNowNs(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//log-linear histogram: 8 sub-buckets per power of two (<= 12.5% bucket width),
+//fixed storage, so recording on the hot path never allocates
+class LatencyHistogram{
+public:
+    void record(std::int64_t ns){
+        if(ns < 0){ns = 0;}
+        const auto v = static_cast<std::uint64_t>(ns);
+        ++buckets_[bucketOf(v)];
+        ++count_;
+        sum_ += v;
+        if(v < min_){min_ = v;}
+        if(v > max_){max_ = v;}
+    }
+
+    std::uint64_t count() const{return count_;}
+    std::uint64_t min() const{return count_ ? min_ : 0;}
+    std::uint64_t max() const{return max_;}
+    double mean() const{return count_ ? static_cast<double>(sum_) / count_ : 0.0;}
+
+    //lower bound of the bucket holding the p-th percentile (p in [0, 100])
+    std::uint64_t percentile(double p) const{
+        if(count_ == 0){return 0;}
+        auto rank = static_cast<std::uint64_t>(p / 100.0 * static_cast<double>(count_));
+        if(rank >= count_){rank = count_ - 1;}
+        std::uint64_t seen = 0;
+        for(std::size_t i = 0; i < kBuckets; ++i){
+            seen += buckets_[i];
+            if(seen > rank){
+                const std::uint64_t lo = lowerBound(i);
+                return lo < min_ ? min_ : (lo > max_ ? max_ : lo);
+            }
+        }
+        return max_;
+    }
+
+    void merge(const LatencyHistogram& other){
+        for(std::size_t i = 0; i < kBuckets; ++i){buckets_[i] += other.buckets_[i];}
+        count_ += other.count_;
+        sum_ += other.sum_;
+        if(other.min_ < min_){min_ = other.min_;}
+        if(other.max_ > max_){max_ = other.max_;}
+    }
+
+private:
+    static constexpr unsigned kSubBits = 3;
+    static constexpr std::size_t kSub = std::size_t{1} << kSubBits;
+    static constexpr std::size_t kBuckets = (64 - kSubBits + 1) * kSub;
+
+    std::array<std::uint64_t, kBuckets> buckets_{};
+    std::uint64_t count_{0};
+    std::uint64_t sum_{0};
+    std::uint64_t min_{std::numeric_limits<std::uint64_t>::max()};
+    std::uint64_t max_{0};
+
+    static std::size_t bucketOf(std::uint64_t v){
+        if(v < kSub){return static_cast<std::size_t>(v);}
+        const unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(v));
+        const unsigned shift = msb - kSubBits;
+        return (msb - kSubBits + 1) * kSub + ((v >> shift) & (kSub - 1));
+    }
+
+    static std::uint64_t lowerBound(std::size_t idx){
+        if(idx < kSub){return idx;}
+        const std::size_t msb = idx / kSub + kSubBits - 1;
+        return (kSub + idx % kSub) << (msb - kSubBits);
+    }
+};
+
+//tick-to-trade for one strategy. Every order op is measured from the book
+//change (or fill) that made the strategy requote:
+//  decision: trigger -> op handed to the gateway
+//  ack:      trigger -> gateway call returned (engine accepted/rejected it)
+struct TickToTradeStats{
+    LatencyHistogram decision;
+    LatencyHistogram ack;
+    std::uint64_t reactions{0}; //triggered ticks that sent at least one op
+    std::uint64_t idle_ticks{0};//triggered ticks that left quotes unchanged
+};
+
+inline void printLatency(std::ostream& os, const char* name, const LatencyHistogram& h){
+    os << name << " n=" << h.count()
+       << " p50=" << h.percentile(50) << "ns"
+       << " p99=" << h.percentile(99) << "ns"
+       << " max=" << h.max() << "ns";
+}
+
+inline void printTickToTrade(std::ostream& os, const TickToTradeStats& s){
+    os << "reactions=" << s.reactions << " idle=" << s.idle_ticks << " ";
+    printLatency(os, "decision", s.decision);
+    os << " ";
+    printLatency(os, "ack", s.ack);
+    os << "\n";
+}
+
+//gateway decorator timing each op against the tick's trigger timestamp.
+//Only the ops pass through; topOfBook is forwarded untimed
+template<typename Gateway>
+class TimedGateway{
+public:
+    TimedGateway(Gateway& inner, std::int64_t trigger_ns, TickToTradeStats& stats):
+        inner_(inner), trigger_ns_(trigger_ns), stats_(stats){}
+
+    ~TimedGateway(){
+        if(ops_ != 0){++stats_.reactions;}
+        else{++stats_.idle_ticks;}
+    }
+
+    TimedGateway(const TimedGateway&) = delete;
+    TimedGateway& operator=(const TimedGateway&) = delete;
+
+    auto topOfBook(SymbolId symbol) const{return inner_.topOfBook(symbol);}
+
+    OrderId newLimit(SymbolId symbol, UserId user, Side side, Price price, Qty qty,
+                     TimeInForce tif = TimeInForce::GFD){
+        begin();
+        OrderId id = inner_.newLimit(symbol, user, side, price, qty, tif);
+        end();
+        return id;
+    }
+
+    bool cancel(SymbolId symbol, OrderId id){
+        begin();
+        bool ok = inner_.cancel(symbol, id);
+        end();
+        return ok;
+    }
+
+    OrderId amend(SymbolId symbol, OrderId id, Price price, Qty qty){
+        begin();
+        OrderId out = inner_.amend(symbol, id, price, qty);
+        end();
+        return out;
+    }
+
+private:
+    Gateway& inner_;
+    std::int64_t trigger_ns_;
+    TickToTradeStats& stats_;
+    std::uint32_t ops_{0};
+
+    void begin(){
+        ++ops_;
+        stats_.decision.record(latencyNowNs() - trigger_ns_);
+    }
+
+    void end(){stats_.ack.record(latencyNowNs() - trigger_ns_);}
+};
+
+}
@@ -0,0 +1,510 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace matching{
+
+struct LogWriterOptions{
+    std::size_t buffer_bytes{1 << 20}; //per buffer; rounded up to 4 KiB
+    std::size_t buffers{8};            //in flight at most buffers - 1, the producer fills the last
+    bool append{false};                //keep existing content, write after it
+    bool direct{false};                //O_DIRECT when the filesystem allows it
+    std::uint64_t preallocate{0};      //fallocate this many bytes up front (trimmed on close)
+    bool io_uring{true};               //false: always use the writer-thread backend
+};
+
+namespace detail{
+
+struct LogCompletion{
+    std::uint32_t buffer;
+    std::int64_t result; //bytes written or -errno
+};
+
+//moves whole buffers to the file; the writer only ever waits inside reap(true)
+class LogBackend{
+public:
+    virtual ~LogBackend() = default;
+    virtual const char* name() const = 0;
+    virtual void submit(std::uint32_t buffer, const std::byte* data, std::size_t len, std::uint64_t offset) = 0;
+    virtual void reap(bool wait, std::vector<LogCompletion>& out) = 0;
+};
+
+//portable fallback: a thread doing pwrite, handed buffers under a mutex (one
+//lock per buffer, not per record)
+class ThreadLogBackend final: public LogBackend{
+public:
+    explicit ThreadLogBackend(int fd): fd_(fd), thread_(&ThreadLogBackend::run, this) {}
+
+    ~ThreadLogBackend() override{
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        work_cv_.notify_one();
+        thread_.join();
+    }
+
+    const char* name() const override{return "thread";}
+
+    void submit(std::uint32_t buffer, const std::byte* data, std::size_t len, std::uint64_t offset) override{
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(Job{buffer, data, len, offset});
+        }
+        work_cv_.notify_one();
+    }
+
+    void reap(bool wait, std::vector<LogCompletion>& out) override{
+        std::unique_lock<std::mutex> lock(mutex_);
+        if(wait){done_cv_.wait(lock, [this]{return !done_.empty();});}
+        out.insert(out.end(), done_.begin(), done_.end());
+        done_.clear();
+    }
+
+private:
+    struct Job{
+        std::uint32_t buffer;
+        const std::byte* data;
+        std::size_t len;
+        std::uint64_t offset;
+    };
+
+    int fd_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    std::deque<Job> jobs_;
+    std::vector<LogCompletion> done_;
+    bool stop_{false};
+    std::thread thread_;
+
+    void run(){
+        std::unique_lock<std::mutex> lock(mutex_);
+        while(true){
+            work_cv_.wait(lock, [this]{return stop_ || !jobs_.empty();});
+            if(jobs_.empty()){return;}
+            const Job job = jobs_.front();
+            jobs_.pop_front();
+            lock.unlock();
+            std::int64_t written = 0;
+            while(static_cast<std::size_t>(written) < job.len){
+                const ssize_t n = ::pwrite(fd_, job.data + written, job.len - written,
+                                           static_cast<off_t>(job.offset + written));
+                if(n < 0){
+                    if(errno == EINTR){continue;}
+                    written = -errno;
+                    break;
+                }
+                written += n;
+            }
+            lock.lock();
+            done_.push_back(LogCompletion{job.buffer, written});
+            done_cv_.notify_one();
+        }
+    }
+};
+
+#if defined(__linux__)
+
+//io_uring through the raw syscalls (no liburing): buffers registered once and
+//written with WRITE_FIXED; submissions batch until the next reap, and reaping
+//reads the completion ring without entering the kernel unless told to wait
+class UringLogBackend final: public LogBackend{
+public:
+    //nullptr when io_uring is unavailable (old kernel, seccomp, ...)
+    static std::unique_ptr<UringLogBackend> create(int fd, const std::vector<iovec>& buffers){
+        std::unique_ptr<UringLogBackend> b(new UringLogBackend(fd));
+        if(!b->setup(static_cast<unsigned>(buffers.size() * 2), buffers)){return nullptr;}
+        return b;
+    }
+
+    ~UringLogBackend() override{
+        if(sqes_ != MAP_FAILED){::munmap(sqes_, sqes_bytes_);}
+        if(cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_){::munmap(cq_ring_, cq_bytes_);}
+        if(sq_ring_ != MAP_FAILED){::munmap(sq_ring_, sq_bytes_);}
+        if(ring_fd_ >= 0){::close(ring_fd_);}
+    }
+
+    const char* name() const override{return fixed_ ? "io_uring" : "io_uring (unregistered buffers)";}
+
+    void submit(std::uint32_t buffer, const std::byte* data, std::size_t len, std::uint64_t offset) override{
+        pending_[buffer] = true;
+        if(failed_ != 0){return;} //failed by the next reap
+        const unsigned tail = *sq_tail_;
+        const unsigned idx = tail & sq_mask_;
+        io_uring_sqe& sqe = static_cast<io_uring_sqe*>(sqes_)[idx];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = fixed_ ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe.fd = file_fd_;
+        sqe.addr = reinterpret_cast<std::uint64_t>(data);
+        sqe.len = static_cast<std::uint32_t>(len);
+        sqe.off = offset;
+        sqe.buf_index = static_cast<std::uint16_t>(buffer);
+        sqe.user_data = buffer;
+        sq_array_[idx] = idx;
+        std::atomic_ref<unsigned>(*sq_tail_).store(tail + 1, std::memory_order_release);
+        ++to_submit_;
+    }
+
+    //a hard io_uring_enter error (not EINTR/EAGAIN/EBUSY) fails every pending
+    //buffer with that errno and every later one too, so a waiting writer sees the
+    //error instead of waiting for completions that will never be posted
+    void reap(bool wait, std::vector<LogCompletion>& out) override{
+        if(failed_ != 0){
+            failPending(out);
+            return;
+        }
+        const std::size_t before = out.size();
+        drainCq(out);
+        if(to_submit_ == 0 && (!wait || out.size() != before)){return;}
+        const unsigned flags = wait && out.size() == before ? IORING_ENTER_GETEVENTS : 0u;
+        const unsigned min_complete = flags ? 1u : 0u;
+        while(true){
+            const long r = ::syscall(__NR_io_uring_enter, ring_fd_, to_submit_, min_complete, flags, nullptr, 0);
+            if(r >= 0){
+                to_submit_ -= static_cast<unsigned>(r);
+                break;
+            }
+            if(errno != EINTR && errno != EAGAIN && errno != EBUSY){
+                failed_ = errno;
+                drainCq(out);
+                failPending(out);
+                return;
+            }
+        }
+        drainCq(out);
+    }
+
+private:
+    int file_fd_;
+    int ring_fd_{-1};
+    bool fixed_{false};
+    void* sq_ring_{MAP_FAILED};
+    void* cq_ring_{MAP_FAILED};
+    void* sqes_{MAP_FAILED};
+    std::size_t sq_bytes_{0};
+    std::size_t cq_bytes_{0};
+    std::size_t sqes_bytes_{0};
+    unsigned* sq_tail_{nullptr};
+    unsigned* sq_array_{nullptr};
+    unsigned sq_mask_{0};
+    unsigned* cq_head_{nullptr};
+    unsigned* cq_tail_{nullptr};
+    unsigned cq_mask_{0};
+    io_uring_cqe* cqes_{nullptr};
+    unsigned to_submit_{0};
+    std::vector<bool> pending_; //by buffer: submitted, completion not reaped yet
+    int failed_{0};             //errno of a hard io_uring_enter failure
+
+    explicit UringLogBackend(int fd): file_fd_(fd) {}
+
+    bool setup(unsigned entries, const std::vector<iovec>& buffers){
+        pending_.assign(buffers.size(), false);
+        io_uring_params p{};
+        ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+        if(ring_fd_ < 0){return false;}
+
+        sq_bytes_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_bytes_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if(single){sq_bytes_ = cq_bytes_ = std::max(sq_bytes_, cq_bytes_);}
+        sq_ring_ = ::mmap(nullptr, sq_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring_fd_, IORING_OFF_SQ_RING);
+        if(sq_ring_ == MAP_FAILED){return false;}
+        cq_ring_ = single ? sq_ring_ : ::mmap(nullptr, cq_bytes_, PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if(cq_ring_ == MAP_FAILED){return false;}
+        sqes_bytes_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = ::mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd_, IORING_OFF_SQES);
+        if(sqes_ == MAP_FAILED){return false;}
+
+        auto* sq = static_cast<char*>(sq_ring_);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        auto* cq = static_cast<char*>(cq_ring_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+        //pinning can fail under a low RLIMIT_MEMLOCK: plain writes still work
+        fixed_ = ::syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS,
+                           buffers.data(), static_cast<unsigned>(buffers.size())) == 0;
+        return true;
+    }
+
+    void drainCq(std::vector<LogCompletion>& out){
+        unsigned head = *cq_head_;
+        const unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+        for(; head != tail; ++head){
+            const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+            out.push_back(LogCompletion{static_cast<std::uint32_t>(cqe.user_data), cqe.res});
+            pending_[cqe.user_data] = false;
+        }
+        std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+    }
+
+    void failPending(std::vector<LogCompletion>& out){
+        for(std::uint32_t i = 0; i < pending_.size(); ++i){
+            if(!pending_[i]){continue;}
+            out.push_back(LogCompletion{i, -static_cast<std::int64_t>(failed_)});
+            pending_[i] = false;
+        }
+    }
+};
+
+#endif
+
+struct AlignedFree{
+    void operator()(std::byte* p) const{std::free(p);}
+};
+
+}
+
+//append-only file writer for journals and logs. Records are copied into the
+//current buffer; a full buffer (or flush()) is handed to the backend and the
+//producer moves on to the next free one, so appending costs a memcpy and only
+//stalls when every buffer is still being written. Completions are picked up
+//opportunistically on each hand-off.
+//
+//Backends: io_uring with registered buffers (Linux), else a pwrite thread.
+//With direct, writes are 4 KiB aligned: a partial flush pads its last block and
+//the next buffer rewrites that block once the earlier writes are done
+class LogWriter{
+public:
+    static constexpr std::size_t kAlign = 4096;
+
+    LogWriter() = default;
+    ~LogWriter(){close();}
+
+    LogWriter(const LogWriter&) = delete;
+    LogWriter& operator=(const LogWriter&) = delete;
+
+    bool open(const std::string& path, const LogWriterOptions& options = {}){
+        close();
+        opts_ = options;
+        opts_.buffer_bytes = std::max(kAlign, (opts_.buffer_bytes + kAlign - 1) & ~(kAlign - 1));
+        opts_.buffers = std::max<std::size_t>(2, opts_.buffers);
+
+        const int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (opts_.append ? 0 : O_TRUNC);
+        direct_ = false;
+        #if defined(__linux__)
+        if(opts_.direct){
+            fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+            direct_ = fd_ >= 0;
+        }
+        #endif
+        if(fd_ < 0){fd_ = ::open(path.c_str(), flags, 0644);}
+        if(fd_ < 0){return false;}
+
+        struct stat st{};
+        base_ = opts_.append && ::fstat(fd_, &st) == 0 ? static_cast<std::uint64_t>(st.st_size) : 0;
+        if(direct_ && base_ % kAlign != 0){
+            //unaligned tail: fall back to buffered writes for this file
+            ::close(fd_);
+            fd_ = ::open(path.c_str(), flags, 0644);
+            direct_ = false;
+            if(fd_ < 0){return false;}
+        }
+        #if defined(__linux__)
+        if(opts_.preallocate != 0){::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(base_),
+                                               static_cast<off_t>(opts_.preallocate));}
+        #endif
+
+        const std::size_t total = opts_.buffer_bytes * opts_.buffers;
+        memory_.reset(static_cast<std::byte*>(std::aligned_alloc(kAlign, total)));
+        if(!memory_){
+            ::close(fd_);
+            fd_ = -1;
+            return false;
+        }
+        bufs_.assign(opts_.buffers, Buffer{});
+        std::vector<iovec> iov(opts_.buffers);
+        for(std::size_t i = 0; i < opts_.buffers; ++i){
+            bufs_[i].data = memory_.get() + i * opts_.buffer_bytes;
+            iov[i] = iovec{bufs_[i].data, opts_.buffer_bytes};
+        }
+        #if defined(__linux__)
+        if(opts_.io_uring){backend_ = detail::UringLogBackend::create(fd_, iov);}
+        #endif
+        if(!backend_){backend_ = std::make_unique<detail::ThreadLogBackend>(fd_);}
+
+        cur_ = 0;
+        bufs_[0].file_off = base_;
+        logical_ = 0;
+        in_flight_ = 0;
+        drain_before_submit_ = false;
+        error_ = 0;
+        submits_ = 0;
+        stalls_ = 0;
+        return true;
+    }
+
+    bool isOpen() const{return fd_ >= 0;}
+
+    void append(const void* data, std::size_t n){
+        const auto* src = static_cast<const std::byte*>(data);
+        while(n > 0){
+            Buffer& b = bufs_[cur_];
+            const std::size_t k = std::min(n, opts_.buffer_bytes - b.len);
+            std::memcpy(b.data + b.len, src, k);
+            b.len += k;
+            src += k;
+            n -= k;
+            logical_ += k;
+            if(b.len == opts_.buffer_bytes){rotate();}
+        }
+    }
+
+    void append(std::string_view s){append(s.data(), s.size());}
+
+    template<typename T>
+    void appendPod(const T& v){append(&v, sizeof(T));}
+
+    //hand the partial buffer to the backend; does not wait for the write
+    void flush(){
+        if(fd_ < 0){return;}
+        if(bufs_[cur_].len > carried_){rotate();}
+        else{reap(false);}
+    }
+
+    //wait until everything appended so far reached the file
+    void sync(){
+        flush();
+        while(in_flight_ != 0){reap(true);}
+    }
+
+    void close(){
+        if(fd_ < 0){return;}
+        sync();
+        backend_.reset();
+        if(direct_ || opts_.preallocate != 0){
+            [[maybe_unused]] int r = ::ftruncate(fd_, static_cast<off_t>(base_ + logical_));
+        }
+        ::close(fd_);
+        fd_ = -1;
+        memory_.reset();
+        bufs_.clear();
+    }
+
+    std::uint64_t bytesAppended() const{return logical_;}
+    std::uint64_t submits() const{return submits_;}
+    std::uint64_t stalls() const{return stalls_;} //appends that had to wait for a free buffer
+    int error() const{return error_;}             //first write errno, 0 if none
+    bool direct() const{return direct_;}
+    const char* backend() const{return backend_ ? backend_->name() : "closed";}
+
+private:
+    struct Buffer{
+        std::byte* data{nullptr};
+        std::size_t len{0};       //filled bytes
+        std::uint64_t file_off{0};
+        std::size_t io_len{0};    //bytes being written
+        std::size_t io_done{0};
+        bool in_flight{false};
+    };
+
+    LogWriterOptions opts_;
+    int fd_{-1};
+    bool direct_{false};
+    std::unique_ptr<std::byte, detail::AlignedFree> memory_;
+    std::vector<Buffer> bufs_;
+    std::unique_ptr<detail::LogBackend> backend_;
+    std::vector<detail::LogCompletion> completions_;
+    std::size_t cur_{0};
+    std::size_t carried_{0};    //head of the current buffer re-copied from the previous one
+    std::uint64_t base_{0};     //file size at open (append mode)
+    std::uint64_t logical_{0};
+    std::size_t in_flight_{0};
+    bool drain_before_submit_{false};
+    int error_{0};
+    std::uint64_t submits_{0};
+    std::uint64_t stalls_{0};
+
+    void rotate(){
+        Buffer& b = bufs_[cur_];
+        std::size_t write_len = b.len;
+        std::size_t keep = b.len; //bytes the next buffer starts after
+        std::size_t carry = 0;
+        if(direct_){
+            write_len = (b.len + kAlign - 1) & ~(kAlign - 1);
+            std::memset(b.data + b.len, 0, write_len - b.len);
+            keep = b.len & ~(kAlign - 1);
+            carry = b.len - keep;
+        }
+        if(drain_before_submit_){
+            while(in_flight_ != 0){reap(true);}
+            drain_before_submit_ = false;
+        }
+        b.io_len = write_len;
+        b.io_done = 0;
+        b.in_flight = true;
+        ++in_flight_;
+        ++submits_;
+        backend_->submit(static_cast<std::uint32_t>(cur_), b.data, write_len, b.file_off);
+
+        const std::size_t next = (cur_ + 1) % bufs_.size();
+        reap(false);
+        if(bufs_[next].in_flight){
+            ++stalls_;
+            while(bufs_[next].in_flight){reap(true);}
+        }
+        Buffer& n = bufs_[next];
+        n.file_off = b.file_off + keep;
+        n.len = carry;
+        if(carry != 0){
+            std::memcpy(n.data, b.data + keep, carry);
+            drain_before_submit_ = true; //the padded block is in flight: rewrite it after
+        }
+        carried_ = carry;
+        cur_ = next;
+    }
+
+    void reap(bool wait){
+        completions_.clear();
+        backend_->reap(wait, completions_);
+        for(const auto& c: completions_){
+            Buffer& b = bufs_[c.buffer];
+            if(c.result <= 0){
+                if(error_ == 0){error_ = c.result < 0 ? static_cast<int>(-c.result) : EIO;}
+            }
+            else if(b.io_done + static_cast<std::size_t>(c.result) < b.io_len){
+                //short write: send the rest of this buffer
+                b.io_done += static_cast<std::size_t>(c.result);
+                backend_->submit(c.buffer, b.data + b.io_done, b.io_len - b.io_done, b.file_off + b.io_done);
+                continue;
+            }
+            b.in_flight = false;
+            b.len = 0;
+            --in_flight_;
+        }
+    }
+};
+
+}
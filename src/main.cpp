@@ -1,13 +1,36 @@
 #include "matching_engine.hpp"
 #include "async_matching_engine.hpp"
+#include "async_gateway.hpp"
+#include "coro_strategy.hpp"
+#include "fingerprint.hpp"
+#include "hot_standby.hpp"
+#include "backtest.hpp"
+#include "book_history.hpp"
+#include "journal.hpp"
+#include "paced_replay.hpp"
 #include "market_maker.hpp"
 #include "protocol.hpp"
+#include "read_replica.hpp"
+#include "shm_gateway.hpp"
+#include "socket_gateway.hpp"
+#include "sim.hpp"
+#include "strategy_host.hpp"
+#include "sweep.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <atomic>
+#include <deque>
+#include <iomanip>
 #include <iostream>
 #include <random>
 #include <chrono>
 #include <vector>
 #include <fstream>
 #include <unordered_set>
+#if defined(__linux__)
+#include <sys/wait.h>
+#endif
 
 using namespace matching;
 
@@ -166,8 +189,8 @@ void runInteractive(){
               << "  C,symbol,orderId\n"
               << "  R,symbol,oldId,B|S,price,qty,GFD|IOC|FOK\n\n";
 
-    AsyncMatchingEngine async_eng([](const Trade& t){
-        std::cout << "TRADE " << t.symbol_name
+    AsyncMatchingEngine async_eng([&async_eng](const Trade& t){
+        std::cout << "TRADE " << async_eng.engine().symbolName(t.symbol_id)
                   << " px="  << t.price
                   << " qty=" << t.qty
                   << " buy=" << t.buy_id
@@ -203,6 +226,104 @@ void runInteractive(){
     async_eng.stop();
 }
 
+//"T,symbol,price,qty,buyId,sellId,seq,eventSeq,tsNs\n" without going through an ostream
+void appendTradeLine(matching::LogWriter& log, const matching::Trade& t, const std::string& symbol){
+    char buf[256];
+    char* p = buf;
+    char* const end = buf + sizeof(buf) - 1; //room for the newline
+    auto field = [&](auto v){
+        if(p == end){return;}
+        *p++ = ',';
+        p = std::to_chars(p, end, v).ptr;
+    };
+    *p++ = 'T';
+    *p++ = ',';
+    const std::size_t len = std::min<std::size_t>(symbol.size(), 64);
+    std::memcpy(p, symbol.data(), len);
+    p += len;
+    field(t.price);
+    field(t.qty);
+    field(t.buy_id);
+    field(t.sell_id);
+    field(t.seq);
+    field(t.event_seq);
+    field(t.ts_ns);
+    *p++ = '\n';
+    log.append(buf, static_cast<std::size_t>(p - buf));
+}
+
+//trade-log throughput: ofstream flushed per line (the old interactive path)
+//against LogWriter on each backend, timing every append
+void runLogBench(std::size_t records, const std::string& dir){
+    using namespace matching;
+    const std::string path = dir + "/orderbook-log-bench.log";
+    const std::string names[2] = {"MSFT", "AAPL"};
+    std::vector<Trade> trades(1024);
+    for(std::size_t i = 0; i < trades.size(); ++i){
+        trades[i] = Trade{};
+        trades[i].symbol_id = static_cast<SymbolId>(i % 2);
+        trades[i].price = 10000 + static_cast<Price>(i % 50);
+        trades[i].qty = 1 + static_cast<Qty>(i % 100);
+        trades[i].buy_id = static_cast<OrderId>(1000000 + i);
+        trades[i].sell_id = static_cast<OrderId>(2000000 + i);
+    }
+
+    auto report = [&](const char* name, std::size_t n, double seconds, const LatencyHistogram& h){
+        std::cout << std::left << std::setw(28) << name << std::right
+                  << " records/s=" << std::setw(10) << static_cast<std::uint64_t>(n / seconds) << " ";
+        printLatency(std::cout, "append", h);
+        std::cout << "\n";
+    };
+
+    {
+        const std::size_t n = std::min<std::size_t>(records, 200000);
+        std::ofstream out(path, std::ios::trunc);
+        LatencyHistogram h;
+        const auto t0 = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < n; ++i){
+            const Trade& t = trades[i & 1023];
+            const auto a = latencyNowNs();
+            out << "T," << names[t.symbol_id] << "," << t.price << "," << t.qty << ","
+                << t.buy_id << "," << t.sell_id << "\n";
+            out.flush();
+            h.record(latencyNowNs() - a);
+        }
+        out.close();
+        report("ofstream, flush per line", n, std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0).count() / 1e9, h);
+    }
+
+    struct Variant{const char* name; bool io_uring; bool direct;};
+    for(const Variant v: {Variant{"LogWriter thread", false, false}, Variant{"LogWriter io_uring", true, false},
+                          Variant{"LogWriter io_uring O_DIRECT", true, true}}){
+        LogWriterOptions options;
+        options.io_uring = v.io_uring;
+        options.direct = v.direct;
+        options.preallocate = v.direct ? records * 48 : 0;
+        LogWriter log;
+        if(!log.open(path, options)){
+            std::cerr << "cannot open " << path << "\n";
+            return;
+        }
+        LatencyHistogram h;
+        const auto t0 = std::chrono::steady_clock::now();
+        for(std::size_t i = 0; i < records; ++i){
+            const auto a = latencyNowNs();
+            const Trade& t = trades[i & 1023];
+            appendTradeLine(log, t, names[t.symbol_id]);
+            h.record(latencyNowNs() - a);
+        }
+        log.sync();
+        const double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0).count() / 1e9;
+        const std::string label = std::string(v.name) + " [" + log.backend() + (log.direct() ? ", direct" : "") + "]";
+        report(v.name, records, seconds, h);
+        std::cout << "    backend=" << label << " submits=" << log.submits() << " stalls=" << log.stalls()
+                  << " bytes=" << log.bytesAppended() << (log.error() ? " WRITE ERROR" : "") << "\n";
+    }
+    std::remove(path.c_str());
+}
+
 void runInteractiveSync(){
     using namespace matching;
 
@@ -213,36 +334,46 @@ void runInteractiveSync(){
               << "  C,symbol,orderId\n"
               << "  R,symbol,oldId,B|S,price,qty,GFD|IOC|FOK\n\n";
 
-    //open logs in append mode
-    std::ofstream eventLog("events.log", std::ios::app);
-    std::ofstream tradeLog("trades.log", std::ios::app);
-    if(!eventLog || !tradeLog){
+    //open logs in append mode; lines are handed to the disk once per input line
+    LogWriterOptions log_options;
+    log_options.append = true;
+    log_options.buffer_bytes = 64 << 10;
+    log_options.buffers = 4;
+    LogWriter eventLog;
+    LogWriter tradeLog;
+    if(!eventLog.open("events.log", log_options) || !tradeLog.open("trades.log", log_options)){
         std::cerr << "Error: could not open events.log or trades.log for writing\n";
         return;
     }
 
     MatchingEngine engine([&](const Trade& t){
-        std::cout << "TRADE " << t.symbol_name
+        const std::string& symbol = engine.symbolName(t.symbol_id);
+        std::cout << "TRADE " << symbol
                   << " px="  << t.price
                   << " qty=" << t.qty
                   << " buy=" << t.buy_id
                   << " sell="<< t.sell_id
                   << "\n";
-        tradeLog << "T," << t.symbol_name << ","
-                 << t.price << ","
-                 << t.qty << ","
-                 << t.buy_id << ","
-                 << t.sell_id << "\n";
-        tradeLog.flush();
+        appendTradeLine(tradeLog, t, symbol);
     });
+    //D and U lines are answered by a replica, after it caught up with every prior line.
+    //Lines arrive at typing speed, so a small ring is plenty
+    ReadReplica replica(1 << 12);
+
+    //order lines are followed by the id the engine assigned, so replay can remap ids
+    auto logAck = [&](OrderId id){
+        eventLog.append(formatAckLine(id));
+        eventLog.append("\n");
+    };
 
     std::string line;
-    while(std::getline(std::cin , line)){
+    //the previous line's events and trades go out before blocking on the next one
+    while((eventLog.flush(), tradeLog.flush(), std::getline(std::cin , line))){
         std::string trimmed = matching::trim(line);
         if(trimmed.empty()){continue;}
 
-        eventLog << trimmed << "\n";
-        eventLog.flush();
+        eventLog.append(trimmed);
+        eventLog.append("\n");
 
         //depth command: D,symbol[,depth]
         if(!trimmed.empty() && trimmed[0] == 'D'){
@@ -262,9 +393,11 @@ void runInteractiveSync(){
                     depth = 5;
                 }
             }
-            const auto* book = engine.findBook(symbol);
-            if(!book){std::cout << "No book for symbol: " << symbol << "\n";}
-            else{book->printBook(std::cout, depth);}
+            replica.query([&](const MatchingEngine& view){
+                const auto* book = view.findBook(symbol);
+                if(!book){std::cout << "No book for symbol: " << symbol << "\n";}
+                else{book->printBook(std::cout, depth);}
+            }, replica.fed());
             continue;
         }
 
@@ -278,7 +411,9 @@ void runInteractiveSync(){
                 UserId user = static_cast<UserId>(std::stoll(matching::trim(fields[1])));
                 std::string symbol = matching::trim(fields[2]);
 
-                auto posOpt = engine.userPositions(user, symbol);
+                auto posOpt = replica.query([&](const MatchingEngine& view){
+                    return view.userPositions(user, symbol);
+                }, replica.fed());
                 if(!posOpt){std::cout << "User " << user << " has no position in " << symbol << "\n";}
                 else{
                     auto pos = *posOpt;
@@ -297,10 +432,12 @@ void runInteractiveSync(){
         }
         Event e{};
         if(!parseLine(trimmed, e)){continue;}
+        const InternalEvent ie = engine.toInternal(e);
 
         switch(e.type){
         case EventType::NewLimit:{
             OrderId id = engine.newLimit(e.symbol, e.user_id, e.side, e.price, e.qty, e.tif);
+            logAck(id);
             std::cout << "ACK L id=" << id << " symbol=" << e.symbol
                       << " side=" << (e.side == Side::Buy ? "B" : "S")
                       << " px=" << e.price << " qty=" << e.qty
@@ -311,6 +448,7 @@ void runInteractiveSync(){
         }
         case EventType::NewMarket:{
             OrderId id = engine.newMarket(e.symbol, e.user_id, e.side, e.qty);
+            logAck(id);
             std::cout << "ACK M id=" << id << " symbol=" << e.symbol
                       << " side=" << (e.side == Side::Buy ? "B" : "S")
                       << " qty=" << e.qty << "\n";
@@ -323,14 +461,22 @@ void runInteractiveSync(){
             break;
         }
         case EventType::Replace:{
-            OrderId newId = engine.replace(e.symbol, e.id, e.side, e.price, e.qty, e.tif);
+            OrderId newId = engine.processInternal(ie);
+            logAck(newId);
             std::cout << "ACK R old_id=" << e.id << " new_id=" << newId
                       << " symbol=" << e.symbol << "\n";
             break;
         }
+        case EventType::Amend:{
+            OrderId id = engine.amend(ie.symbol, e.id, e.price, e.qty, ie.user_id);
+            logAck(id);
+            std::cout << "ACK A old_id=" << e.id << " id=" << id << " symbol=" << e.symbol << "\n";
+            break;
+        }
         case EventType::Stop:
             break;
         }
+        replica.feed(ie, engine.symbolIndex());
         auto tob = engine.topOfBook(e.symbol);
         std::cout << e.symbol << " bid="
                   << (tob.best_bid ? std::to_string(*tob.best_bid) : "none")
@@ -345,7 +491,8 @@ void runInteractiveSync(){
     }
 }
 
-void runReplay(const std::string& filename){
+//checkpoint_every > 0: print the running fingerprint every that many events
+void runReplay(const std::string& filename, std::uint64_t checkpoint_every){
     using namespace matching;
 
     std::ifstream in(filename);
@@ -353,17 +500,41 @@ void runReplay(const std::string& filename){
         std::cerr << "ERROR: cannot open replay file: " << filename << "\n";
         return;
     }
-    MatchingEngine engine([](const Trade& t){
-        (void)t;
+    ReplayFingerprint fingerprint;
+    MatchingEngine engine([&](const Trade& t){
+        fingerprint.onTrade(t);
     });
     std::string line;
     std::unordered_set<std::string> symbols;
 
+    //recorded ids are remapped to this engine's: from the "#ack" line after
+    //each order when the log has one, else by inference
+    TapeIdRemap ids;
+    InternalEvent pending{};
+    OrderId pending_live = 0;
+    bool unacked = false;
+
     while(std::getline(in, line)){
+        OrderId ack = 0;
+        if(parseAckLine(trim(line), ack)){
+            if(unacked){ids.assigned(pending, pending_live, ack);}
+            unacked = false;
+            continue;
+        }
         matching::Event e{};
         if(!parseLine(line, e)){continue;}
+        if(unacked){ids.assigned(pending, pending_live);}
         symbols.insert(e.symbol);
-        engine.process(e);
+        InternalEvent ie = engine.toInternal(e);
+        ids.resolve(ie);
+        pending = ie;
+        pending_live = engine.processInternal(ie);
+        unacked = assignsId(ie.type);
+        fingerprint.onEvent(pending_live);
+        if(checkpoint_every != 0 && fingerprint.events() % checkpoint_every == 0){
+            std::cout << "checkpoint events=" << fingerprint.events() << " trades=" << fingerprint.trades()
+                      << " fp=" << hex64(fingerprint.checkpoint()) << "\n";
+        }
     }
     std::cout << "\n--- Replay summary for file: " << filename << " ---\n";
     for(const auto& sym : symbols){
@@ -383,10 +554,49 @@ void runReplay(const std::string& filename){
             std::cout << "  trades=" << stats->trade_count
                       << " volume=" << stats->traded_qty;
             if(stats->has_last_trade){
-                std::cout << " last_px=" << stats->last_trade_price;
+                std::cout << " last_px=" << stats->last_trade_price
+                          << " high=" << stats->high
+                          << " low=" << stats->low
+                          << " vwap=" << stats->vwap();
             }
             std::cout << "\n";
         }
+        if(const auto* book = engine.findBook(sym)){
+            std::cout << "  trades_fp=" << hex64(fingerprint.symbolTrades(book->symbolId()))
+                      << " book_fp=" << hex64(bookFingerprint(*book)) << "\n";
+        }
+    }
+    std::cout << "fingerprint=" << hex64(fingerprint.value(engine)) << " events=" << fingerprint.events()
+              << " trades=" << fingerprint.trades() << "\n";
+}
+
+//replays a journal through the async engine at its recorded pace; speed 0 = max
+void runPacedReplay(const std::string& path, double speed){
+    using namespace matching;
+    EventTape tape;
+    if(!loadEventTape(path, tape)){
+        std::cerr << "ERROR: cannot load journal: " << path << "\n";
+        return;
+    }
+    if(tape.timestamps.empty() && speed > 0){
+        std::cerr << "WARNING: " << path << " has no timestamps, replaying at max speed\n";
+    }
+    std::atomic<std::uint64_t> trades{0};
+    AsyncMatchingEngine async_eng([&](const Trade&){trades.fetch_add(1, std::memory_order_relaxed);});
+    for(const auto& name: tape.symbols){async_eng.engine().resolveSymbol(name);}
+
+    PacingStats stats = replayPaced(tape, speed, [&](const InternalEvent& e){async_eng.submit(e);});
+    async_eng.stop();
+
+    const double elapsed_s = stats.elapsed_ns / 1e9;
+    std::cout << path << ": " << stats.events << " events, " << trades.load() << " trades, recorded span "
+              << stats.recorded_ns / 1e9 << "s, replayed in " << elapsed_s << "s";
+    if(stats.recorded_ns > 0 && elapsed_s > 0){std::cout << " (" << stats.recorded_ns / 1e9 / elapsed_s << "x)";}
+    std::cout << "\n";
+    if(stats.lateness.count() > 0){
+        std::cout << "release lateness ns: p50=" << stats.lateness.percentile(50)
+                  << " p99=" << stats.lateness.percentile(99) << " p99.9=" << stats.lateness.percentile(99.9)
+                  << " max=" << stats.lateness.max() << "  sleeps=" << stats.sleeps << "\n";
     }
 }
 
@@ -402,10 +612,10 @@ void runMarketMakerDemo(){
     config.max_inventory = 150;
     config.inventory_skew_step = 50;
 
-    SimpleMarketMaker* maker_ptr = nullptr;
+    MarketMakerRouter router;
     MatchingEngine engine([&](const Trade& t){
-        if(maker_ptr && maker_ptr->onTrade(t)){
-            std::cout << "MM_FILL symbol=" << t.symbol_name
+        if(router.onTrade(t)){
+            std::cout << "MM_FILL symbol=" << engine.symbolName(t.symbol_id)
                       << " px=" << t.price
                       << " qty=" << t.qty
                       << " buy=" << t.buy_id
@@ -413,12 +623,16 @@ void runMarketMakerDemo(){
         }
     });
 
+    engine.setBookUpdateCallback([&](SymbolId sid){router.onBookUpdate(sid);});
+
     SimpleMarketMaker maker(config);
-    maker_ptr = &maker;
+    router.enableLatencyStats();
+    router.attach(maker, engine);
+    const SymbolId sym = maker.symbolId();
 
     // Seed an external market around fair value so the maker can quote inside it.
-    engine.newLimit(config.symbol, UserId{1001}, Side::Buy,  config.fair_value - 2, 500);
-    engine.newLimit(config.symbol, UserId{1002}, Side::Sell, config.fair_value + 2, 500);
+    engine.newLimit(sym, UserId{1001}, Side::Buy,  config.fair_value - 2, 500);
+    engine.newLimit(sym, UserId{1002}, Side::Sell, config.fair_value + 2, 500);
 
     std::mt19937_64 rng(42);
     std::uniform_int_distribution<int> side_dist(0, 1);
@@ -426,13 +640,14 @@ void runMarketMakerDemo(){
 
     std::cout << "\n--- Market maker demo ---\n";
     for(int tick = 1; tick <= 40; ++tick){
-        maker.onTick(engine);
+        //requote only if the book moved (including from our own last quotes)
+        router.flush(engine);
 
         Side aggressor_side = side_dist(rng) == 0 ? Side::Buy : Side::Sell;
         Qty qty = qty_dist(rng);
-        engine.newMarket(config.symbol, UserId{2000 + tick}, aggressor_side, qty);
+        engine.newMarket(sym, UserId{2000 + tick}, aggressor_side, qty);
 
-        maker.onTick(engine);
+        router.flush(engine);
         if(tick % 5 == 0){
             std::cout << "tick=" << tick << " ";
             maker.printStatus(engine, std::cout);
@@ -441,7 +656,7 @@ void runMarketMakerDemo(){
 
     maker.cancelAll(engine);
 
-    auto tob = engine.topOfBook(config.symbol);
+    auto tob = engine.topOfBook(sym);
     std::cout << "Final " << config.symbol
               << " bid=" << (tob.best_bid ? std::to_string(*tob.best_bid) : "none")
               << " x " << (tob.bid_size ? std::to_string(*tob.bid_size) : "0")
@@ -449,23 +664,1145 @@ void runMarketMakerDemo(){
               << " x " << (tob.ask_size ? std::to_string(*tob.ask_size) : "0")
               << "\n";
     maker.printStatus(engine, std::cout);
+    if(const TickToTradeStats* lat = router.latencyStats(maker)){
+        std::cout << "MM tick-to-trade ";
+        printTickToTrade(std::cout, *lat);
+    }
+}
+
+//compact (version 2) unless raw; timestamps carry over from a timed source
+//journal size, block layout and decode speed against replaying the same events
+void runJournalInfo(const std::string& path){
+    using namespace matching;
+    CompactJournalReader reader;
+    if(!reader.open(path)){
+        std::cerr << "ERROR: not a compact journal: " << path << "\n";
+        return;
+    }
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    const auto bytes = static_cast<std::uint64_t>(f.tellg());
+
+    EventTape tape;
+    auto t0 = std::chrono::steady_clock::now();
+    if(!reader.readAll(tape)){
+        std::cerr << "ERROR: corrupt journal: " << path << "\n";
+        return;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    MatchingEngine engine([](const Trade&){});
+    for(const auto& name: tape.symbols){engine.resolveSymbol(name);}
+    for(const auto& e: tape.events){engine.processInternal(e);}
+    auto t2 = std::chrono::steady_clock::now();
+
+    const double decode_s = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / 1e9;
+    const double engine_s = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count() / 1e9;
+    const double n = static_cast<double>(tape.events.size());
+    std::cout << path << ": " << tape.events.size() << " events, " << tape.symbols.size() << " symbols, "
+              << reader.blockCount() << " blocks, " << bytes << " bytes ("
+              << (n > 0 ? bytes / n : 0.0) << " B/event vs "
+              << 1 + sizeof(InternalEvent) << " raw)" << (tape.timestamps.empty() ? "" : ", timed") << "\n"
+              << "decode: " << static_cast<std::uint64_t>(n / decode_s) << " events/s   "
+              << "engine replay: " << static_cast<std::uint64_t>(n / engine_s) << " events/s\n";
+}
+
+//replays a timed journal with bars on, each event at its recorded time, and
+//writes every symbol's bars as CSV: symbol,startNs,open,high,low,close,volume,trades
+void runBars(const std::string& path, std::int64_t interval_ms, const std::string& out_path){
+    using namespace matching;
+    EventTape tape;
+    if(!loadEventTape(path, tape)){
+        std::cerr << "ERROR: cannot load journal: " << path << "\n";
+        return;
+    }
+    if(tape.timestamps.empty()){
+        std::cerr << "ERROR: " << path << " has no timestamps\n";
+        return;
+    }
+    MatchingEngine engine([](const Trade&){});
+    engine.setBarConfig(BarConfig{std::max<std::int64_t>(1, interval_ms) * 1'000'000, 1 << 16});
+    for(const auto& name: tape.symbols){engine.resolveSymbol(name);}
+    for(std::size_t i = 0; i < tape.events.size(); ++i){
+        engine.setReplayTime(tape.timestamps[i]);
+        engine.processInternal(tape.events[i]);
+    }
+
+    std::ofstream file;
+    if(!out_path.empty()){
+        file.open(out_path);
+        if(!file){
+            std::cerr << "ERROR: cannot write " << out_path << "\n";
+            return;
+        }
+    }
+    std::ostream& out = out_path.empty() ? std::cout : file;
+    out << "symbol,startNs,open,high,low,close,volume,trades\n";
+    BarColumns bars;
+    std::size_t total = 0;
+    for(SymbolId sid = 0; sid < tape.symbols.size(); ++sid){
+        bars.clear();
+        if(!engine.exportBars(sid, bars)){continue;}
+        for(std::size_t i = 0; i < bars.size(); ++i){
+            out << tape.symbols[sid] << ',' << bars.start_ns[i] << ',' << bars.open[i] << ',' << bars.high[i] << ','
+                << bars.low[i] << ',' << bars.close[i] << ',' << bars.volume[i] << ',' << bars.trade_count[i] << '\n';
+        }
+        total += bars.size();
+    }
+    if(!out_path.empty()){std::cout << "Wrote " << total << " bars to " << out_path << "\n";}
+}
+
+void runCheckpoints(const std::string& journal, const std::string& out, std::uint64_t every){
+    using namespace matching;
+    auto t0 = std::chrono::steady_clock::now();
+    const std::size_t n = writeBookCheckpoints(journal, out, every);
+    auto t1 = std::chrono::steady_clock::now();
+    if(n == 0){
+        std::cerr << "ERROR: cannot checkpoint " << journal << " into " << out << "\n";
+        return;
+    }
+    std::cout << "Wrote " << n << " checkpoints (every " << every << " events) to " << out << " in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << " ms\n";
+}
+
+//full L3 book of one symbol after the first seq events of a compact journal
+void runBookAt(const std::string& journal, const std::string& symbol, std::uint64_t seq,
+               const std::string& checkpoints){
+    using namespace matching;
+    BookHistory history;
+    if(!history.open(journal, checkpoints)){
+        std::cerr << "ERROR: cannot open " << journal << (checkpoints.empty() ? "" : " / " + checkpoints) << "\n";
+        return;
+    }
+    const auto& names = history.symbols();
+    const auto it = std::find(names.begin(), names.end(), symbol);
+    if(it == names.end()){
+        std::cerr << "ERROR: " << symbol << " is not in " << journal << "\n";
+        return;
+    }
+    MatchingEngine engine;
+    BookQueryStats stats;
+    auto t0 = std::chrono::steady_clock::now();
+    if(!history.bookAt(static_cast<SymbolId>(it - names.begin()), seq, engine, &stats)){
+        std::cerr << "ERROR: corrupt journal: " << journal << "\n";
+        return;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    const auto* book = engine.findBook(symbol);
+    std::cout << symbol << " after event " << std::min(seq, history.events()) << " of " << history.events()
+              << ": from checkpoint " << stats.from_seq << ", " << stats.events_applied << " events from "
+              << stats.blocks_decoded << " blocks in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() << " us\n";
+    std::size_t orders = 0;
+    book->forEachOrder([&](const Order& o){
+        std::cout << (o.side == Side::Buy ? "  BID " : "  ASK ") << o.price << " x " << o.qty << " id=" << o.id << "\n";
+        ++orders;
+    });
+    std::cout << orders << " resting orders, next id " << book->nextOrderId() << "\n";
+}
+
+void runConvert(const std::string& in_path, const std::string& out_path, bool raw){
+    using namespace matching;
+
+    EventTape tape;
+    if(!loadEventTape(in_path, tape)){return;}
+    if(!raw){
+        CompactJournalWriter writer;
+        const bool acked = !tape.assigned.empty();
+        if(!writer.open(out_path, LogWriterOptions{}, acked)){
+            std::cerr << "ERROR: cannot open journal for writing: " << out_path << "\n";
+            return;
+        }
+        const bool timed = !tape.timestamps.empty();
+        for(std::size_t i = 0; i < tape.events.size(); ++i){
+            const InternalEvent& e = tape.events[i];
+            writer.append(e, tape.symbols[e.symbol], timed ? tape.timestamps[i] : 0, acked ? tape.assigned[i] : 0);
+        }
+        if(!writer.close()){
+            std::cerr << "ERROR: write failed: " << out_path << "\n";
+            return;
+        }
+        std::cout << "Wrote " << tape.events.size() << " events (" << tape.symbols.size() << " symbols, "
+                  << writer.bytes() << " bytes) to " << out_path << "\n";
+        return;
+    }
+    JournalWriter writer;
+    if(!writer.open(out_path)){
+        std::cerr << "ERROR: cannot open journal for writing: " << out_path << "\n";
+        return;
+    }
+    for(std::size_t i = 0; i < tape.events.size(); ++i){
+        const InternalEvent& e = tape.events[i];
+        writer.append(e, tape.symbols[e.symbol]);
+        if(!tape.assigned.empty() && assignsId(e.type)){writer.appendAssigned(tape.assigned[i]);}
+    }
+    if(!writer.close()){
+        std::cerr << "ERROR: write failed: " << out_path << "\n";
+        return;
+    }
+    std::cout << "Wrote " << tape.events.size() << " events ("
+              << tape.symbols.size() << " symbols) to " << out_path << "\n";
+}
+
+//--backtest file [--queue] [SYMBOL...]: one default-config maker per listed symbol
+//(all symbols in the file if none listed); --queue uses the queue-position fill model
+void runBacktestMode(const std::string& filename, std::vector<std::string> maker_symbols){
+    using namespace matching;
+
+    EventTape tape;
+    if(!loadEventTape(filename, tape)){return;}
+
+    FillModel fill_model = FillModel::Book;
+    auto queue_flag = std::find(maker_symbols.begin(), maker_symbols.end(), "--queue");
+    if(queue_flag != maker_symbols.end()){
+        fill_model = FillModel::QueuePosition;
+        maker_symbols.erase(queue_flag);
+    }
+
+    std::vector<MarketMakerConfig> makers;
+    for(const auto& sym: maker_symbols.empty() ? tape.symbols : maker_symbols){
+        MarketMakerConfig config{};
+        config.symbol = sym;
+        makers.push_back(config);
+    }
+
+    const std::uint64_t sample_every = std::max<std::uint64_t>(1, tape.events.size() / 20);
+    BacktestResult result = runBacktest(tape, makers, sample_every, fill_model);
+
+    std::cout << "\n--- Backtest: " << filename
+              << (fill_model == FillModel::QueuePosition ? " (queue-position fills)" : "")
+              << " ---\n";
+    std::cout << "time,symbol,position,cash,mtm_pnl,bid_fill_qty,ask_fill_qty,quote_updates\n";
+    auto printRow = [&](const BacktestSample& s){
+        std::cout << s.time << "," << makers[s.maker].symbol
+                  << "," << s.position << "," << s.cash << "," << s.mtm_pnl
+                  << "," << s.bid_filled_qty << "," << s.ask_filled_qty
+                  << "," << s.quote_updates << "\n";
+    };
+    for(const auto& s: result.samples){printRow(s);}
+
+    std::cout << "Final:\n";
+    for(const auto& s: result.final_stats){printRow(s);}
+    std::cout << "Replayed " << result.events << " events (" << result.trades << " trades) in "
+              << result.seconds << " s, ~"
+              << (result.events / std::max(result.seconds, 1e-9) / 1e6) << " M events/s\n";
+}
+
+//--simulate file [order_entry_ns market_data_ns engine_ns]: one maker per symbol,
+//trading through the latency model
+void runSimulateMode(const std::string& filename, const LatencyModel& model){
+    using namespace matching;
+
+    EventTape tape;
+    if(!loadEventTape(filename, tape)){return;}
+
+    LatencySimulator sim(tape, model);
+    for(const auto& sym: tape.symbols){
+        MarketMakerConfig config{};
+        config.symbol = sym;
+        sim.addMaker(config);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    sim.run();
+    auto t1 = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / 1e9;
+
+    const SimStats& st = sim.stats();
+    std::cout << "\n--- Latency simulation: " << filename << " ---\n"
+              << "order_entry_ns=" << model.order_entry_ns
+              << " market_data_ns=" << model.market_data_ns
+              << " engine_ns=" << model.engine_ns << "\n";
+    for(std::uint32_t i = 0; i < sim.makerCount(); ++i){
+        sim.maker(i).printStatus(sim.engine(), std::cout);
+    }
+    std::cout << "virtual_time_ns=" << st.end_time
+              << " tape_events=" << st.tape_events
+              << " strategy_orders=" << st.strategy_orders
+              << " market_data=" << st.market_data
+              << " fills=" << st.fills
+              << " wakeups=" << st.wakeups
+              << " in_flight_at_end=" << st.dropped
+              << " max_engine_backlog_ns=" << st.max_engine_backlog << "\n";
+    const std::uint64_t total = st.tape_events + st.scheduled;
+    std::cout << "Simulated " << total << " events in " << seconds << " s, ~"
+              << (total / seconds / 1e6) << " M events/s\n";
+}
+
+//--sweep file SYMBOL [threads]: grid over MarketMakerConfig on one symbol
+void runSweepMode(const std::string& filename, const std::string& symbol, unsigned threads){
+    using namespace matching;
+
+    EventTape tape;
+    if(!loadEventTape(filename, tape)){return;}
+
+    MarketMakerConfig base{};
+    base.symbol = symbol;
+    auto grid = makeSweepGrid(base, {1, 2, 3, 4}, {25, 50, 100}, {100, 150, 300}, {10, 25, 50});
+
+    auto t0 = std::chrono::steady_clock::now();
+    auto results = runSweep(tape, grid, threads);
+    auto t1 = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / 1e9;
+
+    std::sort(results.begin(), results.end(), [](const SweepResult& a, const SweepResult& b){
+        return a.final_stats.mtm_pnl > b.final_stats.mtm_pnl;
+    });
+
+    std::cout << "\n--- Sweep: " << filename << " symbol=" << symbol << " ---\n";
+    std::cout << "half_spread,skew_step,max_inventory,quote_qty,mtm_pnl,position,bid_fill_qty,ask_fill_qty,quote_updates\n";
+    for(const auto& r: results){
+        std::cout << r.config.half_spread_ticks << "," << r.config.inventory_skew_step
+                  << "," << r.config.max_inventory << "," << r.config.quote_qty
+                  << "," << r.final_stats.mtm_pnl << "," << r.final_stats.position
+                  << "," << r.final_stats.bid_filled_qty << "," << r.final_stats.ask_filled_qty
+                  << "," << r.final_stats.quote_updates << "\n";
+    }
+    std::cout << "Ran " << grid.size() << " backtests x " << tape.events.size() << " events in "
+              << seconds << " s, ~"
+              << (static_cast<double>(grid.size()) * tape.events.size() / seconds / 1e6)
+              << " M events/s aggregate\n";
+}
+
+void runMarketMakerFleet(std::size_t num_symbols, int ticks, std::size_t levels){
+    using namespace matching;
+
+    StrategyHost host;
+    MatchingEngine engine([&](const Trade& t){host.onTrade(t);});
+    engine.setBookUpdateCallback([&](SymbolId sid){host.onBookUpdate(sid);});
+    host.reserve(num_symbols);
+
+    std::vector<SymbolId> symbols;
+    symbols.reserve(num_symbols);
+    for(std::size_t i = 0; i < num_symbols; ++i){
+        MarketMakerConfig config{};
+        config.symbol = "S" + std::to_string(i);
+        config.user_id = UserId{9001};
+        config.levels = levels;
+        auto slot = host.add(engine, config);
+        if(!slot){continue;}
+        SymbolId sid = host.symbolOf(*slot);
+        symbols.push_back(sid);
+        engine.newLimit(sid, UserId{1001}, Side::Buy,  config.fair_value - 2, 500);
+        engine.newLimit(sid, UserId{1002}, Side::Sell, config.fair_value + 2, 500);
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<int> side_dist(0, 1);
+    std::uniform_int_distribution<int> qty_dist(5, 20);
+
+    std::cout << "\n--- Market maker fleet (" << symbols.size() << " symbols) ---\n";
+    auto t0 = std::chrono::steady_clock::now();
+    for(int tick = 1; tick <= ticks; ++tick){
+        host.onTick(engine);
+        for(SymbolId sid: symbols){
+            Side aggressor_side = side_dist(rng) == 0 ? Side::Buy : Side::Sell;
+            engine.newMarket(sid, UserId{2000}, aggressor_side, qty_dist(rng));
+        }
+        host.onTick(engine);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    host.cancelAll(engine);
+
+    double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / 1e9;
+    long long total_cash = 0;
+    Qty gross_position = 0;
+    std::uint64_t quote_updates = 0;
+    for(std::uint32_t slot = 0; slot < host.size(); ++slot){
+        const MarketMakerStats st = host.stats(slot);
+        total_cash += st.cash;
+        gross_position += st.position < 0 ? -st.position : st.position;
+        quote_updates += st.quote_updates;
+    }
+    std::cout << "ticks=" << ticks << " makers=" << host.size()
+              << " in " << seconds << " s, ~"
+              << (static_cast<double>(ticks) * host.size() / seconds / 1e6) << " M maker-ticks/s\n"
+              << "quote_updates=" << quote_updates
+              << " gross_position=" << gross_position
+              << " total_cash=" << total_cash << "\n";
+}
+
+#if defined(__linux__)
+//primary's end-of-run replication line; the standby prints the same state_hash
+void printReplication(const matching::ReplicationPublisher& feed, const matching::MatchingEngine& engine){
+    std::cout << "replication " << feed.name() << ": published=" << feed.published()
+              << " standby_applied=" << feed.standbyApplied() << " stalls=" << feed.stalls()
+              << (feed.abandoned() ? " ABANDONED" : "")
+              << " state_hash=" << matching::hex64(matching::engineStateHash(engine)) << "\n";
+}
+#endif
+
+//one strategy thread per symbol, each with its own session rings to the
+//engine thread; the main thread plays external flow through submit()
+//journal: optional timed compact journal of everything the engine applied;
+//replicate: optional shared-memory segment a --standby process follows
+void runAsyncMarketMakers(std::size_t num_strategies, int ticks, const std::string& journal,
+                          const std::string& replicate){
+    using namespace matching;
+
+    std::atomic<std::uint64_t> trades{0};
+    ReadReplica replica; //the main thread's depth queries go here, not to the engine thread
+    #if defined(__linux__)
+    std::optional<ReplicationPublisher> standby_feed;
+    #endif
+    AsyncMatchingEngine async_eng([&](const Trade&){trades.fetch_add(1, std::memory_order_relaxed);});
+    async_eng.replicateTo(replica);
+    if(!journal.empty() && !async_eng.journalTo(journal)){
+        std::cerr << "ERROR: cannot open journal: " << journal << "\n";
+        return;
+    }
+    #if defined(__linux__)
+    if(!replicate.empty()){async_eng.replicateTo(standby_feed.emplace(replicate));}
+    #else
+    if(!replicate.empty()){std::cerr << "replication requires Linux, ignoring --replicate\n";}
+    #endif
+
+    std::vector<SymbolId> symbols;
+    std::vector<StrategySession*> sessions;
+    std::deque<SimpleMarketMaker> makers;
+    for(std::size_t i = 0; i < num_strategies; ++i){
+        MarketMakerConfig config{};
+        config.symbol = "AMM" + std::to_string(i);
+        makers.emplace_back(config);
+        makers.back().attach(async_eng.engine()); //resolve before any thread uses the id
+        symbols.push_back(makers.back().symbolId());
+        sessions.push_back(&async_eng.connect());
+    }
+
+    for(SymbolId sym: symbols){
+        async_eng.submit(InternalEvent{sym, 0, 98, 500, 1001, EventType::NewLimit, Side::Buy, TimeInForce::GFD});
+        async_eng.submit(InternalEvent{sym, 0, 102, 500, 1002, EventType::NewLimit, Side::Sell, TimeInForce::GFD});
+    }
+
+    std::atomic<bool> done{false};
+    std::vector<std::uint64_t> requests(num_strategies, 0);
+    std::vector<std::thread> strategies;
+    for(std::size_t i = 0; i < num_strategies; ++i){
+        strategies.emplace_back([&, i](){
+            AsyncOrderGateway gw(*sessions[i]);
+            SimpleMarketMaker& maker = makers[i];
+            gw.subscribe(maker.symbolId());
+            bool dirty = false;
+            auto onReport = [&](const ExecReport& r){
+                if(r.type == ReportType::Fill){maker.onFill(r.side, r.client_id, r.price, r.qty);}
+                if(r.type == ReportType::Fill || r.type == ReportType::Bbo){dirty = true;}
+            };
+            while(!done.load(std::memory_order_acquire)){
+                if(gw.poll(onReport) == 0 && !dirty){
+                    std::this_thread::yield();
+                    continue;
+                }
+                if(dirty && gw.inFlight() == 0){
+                    dirty = false;
+                    maker.onTick(gw);
+                }
+            }
+            maker.cancelAll(gw);
+            while(gw.openOrders() != 0){
+                if(gw.poll(onReport) == 0){std::this_thread::yield();}
+            }
+            requests[i] = gw.requestsSent();
+            sessions[i]->close();
+        });
+    }
+
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<std::size_t> sym_dist(0, num_strategies - 1);
+    std::uniform_int_distribution<int> side_dist(0, 1);
+    std::uniform_int_distribution<int> qty_dist(5, 20);
+
+    std::uint64_t queries = 0;
+    Qty depth_seen = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for(int tick = 0; tick < ticks; ++tick){
+        if(tick % 100 == 0){
+            depth_seen += replica.query([&](const MatchingEngine& view){
+                Qty depth = 0;
+                for(SymbolId sym: symbols){
+                    if(auto sig = view.bookSignals(sym)){depth += sig->bid_depth + sig->ask_depth;}
+                }
+                return depth;
+            });
+            ++queries;
+        }
+        InternalEvent e{};
+        e.type = EventType::NewMarket;
+        e.symbol = symbols[sym_dist(rng)];
+        e.side = side_dist(rng) == 0 ? Side::Buy : Side::Sell;
+        e.qty = qty_dist(rng);
+        e.user_id = 2000 + tick;
+        async_eng.submit(e);
+        //refill the consumed side so the market stays anchored around 100
+        e.type = EventType::NewLimit;
+        e.side = e.side == Side::Buy ? Side::Sell : Side::Buy;
+        e.price = e.side == Side::Buy ? 98 : 102;
+        async_eng.submit(e);
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    done.store(true, std::memory_order_release);
+    for(auto& th: strategies){th.join();}
+    async_eng.stop();
+    auto t1 = std::chrono::steady_clock::now();
+
+    std::cout << "\n--- Async market makers (" << num_strategies << " strategy threads) ---\n";
+    std::cout << "ticks=" << ticks << " trades=" << trades.load()
+              << " seconds=" << std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / 1e9
+              << "\n";
+    for(std::size_t i = 0; i < num_strategies; ++i){
+        std::cout << "requests=" << requests[i] << " ";
+        makers[i].printStatus(async_eng.engine(), std::cout);
+    }
+    const bool match = replica.query([&](const MatchingEngine& view){
+        for(SymbolId sym: symbols){
+            const auto* a = async_eng.engine().findBook(sym);
+            const auto* b = view.findBook(sym);
+            if(!a || !b || bookFingerprint(*a) != bookFingerprint(*b)){return false;}
+        }
+        return true;
+    }, replica.fed());
+    std::cout << "replica: applied=" << replica.applied() << " queries=" << queries << " depth_seen=" << depth_seen
+              << " books match primary: " << (match ? "yes" : "NO") << "\n";
+    #if defined(__linux__)
+    if(standby_feed){printReplication(*standby_feed, async_eng.engine());}
+    #endif
+}
+
+//coroutine strategy: per side, one task joins the best price and follows its
+//fills, another pulls the quote whenever it is no longer at the best price
+struct CoroQuote{
+    OrderId id{0};
+    Price price{0};
+};
+
+struct CoroStats{
+    Qty position{0};
+    long long cash{0};
+    std::uint64_t orders{0};
+    std::uint64_t rejects{0};
+    std::uint64_t pulls{0};
+};
+
+Task<> joinBest(CoroGateway& gw, SymbolId sym, Side side, CoroQuote& quote, CoroStats& stats){
+    const Price fallback = side == Side::Buy ? 98 : 102;
+    while(!gw.stopping()){
+        const TopOfBook tob = gw.topOfBook(sym);
+        const std::optional<Price> best = side == Side::Buy ? tob.best_bid : tob.best_ask;
+        const Price px = best.value_or(fallback);
+
+        const PlaceResult ack = co_await gw.place(sym, UserId{9100}, side, px, 10);
+        ++stats.orders;
+        if(!ack.accepted){
+            ++stats.rejects;
+            co_await gw.nextBbo(sym);
+            continue;
+        }
+        quote = CoroQuote{ack.id, px};
+        for(;;){
+            const FillUpdate f = co_await gw.nextFill(ack.id);
+            if(f.qty > 0){
+                const long long notional = static_cast<long long>(f.last_price) * f.qty;
+                stats.position += side == Side::Buy ? f.qty : -f.qty;
+                stats.cash += side == Side::Buy ? -notional : notional;
+            }
+            if(f.done){break;}
+        }
+        quote = CoroQuote{};
+    }
+}
+
+Task<> pullStale(CoroGateway& gw, SymbolId sym, Side side, const CoroQuote& quote, CoroStats& stats){
+    while(!gw.stopping()){
+        const TopOfBook tob = co_await gw.nextBbo(sym);
+        const std::optional<Price> best = side == Side::Buy ? tob.best_bid : tob.best_ask;
+        if(quote.id != 0 && best && *best != quote.price){
+            gw.cancel(sym, quote.id);
+            ++stats.pulls;
+        }
+    }
+}
+
+void runCoroutineStrategy(int ticks){
+    using namespace matching;
+
+    std::atomic<std::uint64_t> trades{0};
+    AsyncMatchingEngine async_eng([&](const Trade&){trades.fetch_add(1, std::memory_order_relaxed);});
+    const SymbolId sym = async_eng.engine().resolveSymbol("CORO");
+    StrategySession& session = async_eng.connect();
+
+    async_eng.submit(InternalEvent{sym, 0, 98, 500, 1001, EventType::NewLimit, Side::Buy, TimeInForce::GFD});
+    async_eng.submit(InternalEvent{sym, 0, 102, 500, 1002, EventType::NewLimit, Side::Sell, TimeInForce::GFD});
+
+    std::atomic<bool> done{false};
+    CoroStats stats;
+    std::thread strategy([&](){
+        CoroGateway gw(session);
+        gw.subscribe(sym);
+        CoroQuote bid, ask;
+        gw.spawn(joinBest(gw, sym, Side::Buy, bid, stats));
+        gw.spawn(joinBest(gw, sym, Side::Sell, ask, stats));
+        gw.spawn(pullStale(gw, sym, Side::Buy, bid, stats));
+        gw.spawn(pullStale(gw, sym, Side::Sell, ask, stats));
+        while(!done.load(std::memory_order_acquire)){
+            if(gw.poll() == 0){std::this_thread::yield();}
+        }
+        gw.shutdown();
+        session.close();
+    });
+
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<int> side_dist(0, 1);
+    std::uniform_int_distribution<int> qty_dist(5, 20);
+    std::uniform_int_distribution<int> px_dist(97, 103);
+    for(int tick = 0; tick < ticks; ++tick){
+        InternalEvent e{};
+        e.symbol = sym;
+        e.user_id = 2000 + tick;
+        e.side = side_dist(rng) == 0 ? Side::Buy : Side::Sell;
+        e.qty = qty_dist(rng);
+        e.type = EventType::NewMarket;
+        async_eng.submit(e);
+        //passive flow keeps the book populated and moves the best prices
+        e.type = EventType::NewLimit;
+        e.side = e.side == Side::Buy ? Side::Sell : Side::Buy;
+        e.price = e.side == Side::Buy ? std::min(px_dist(rng), 99) : std::max(px_dist(rng), 101);
+        async_eng.submit(e);
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    done.store(true, std::memory_order_release);
+    strategy.join();
+    async_eng.stop();
+
+    auto tob = async_eng.engine().topOfBook(sym);
+    const long long mid = tob.mid_price ? *tob.mid_price : 100;
+    std::cout << "\n--- Coroutine strategy ---\n";
+    std::cout << "ticks=" << ticks << " trades=" << trades.load()
+              << " orders=" << stats.orders << " rejects=" << stats.rejects
+              << " pulls=" << stats.pulls
+              << " position=" << stats.position << " cash=" << stats.cash
+              << " mtm_pnl=" << stats.cash + stats.position * mid << "\n";
+}
+
+#if defined(__linux__)
+struct GatewayLoadResult{
+    std::uint64_t orders{0};
+    std::uint64_t cancels{0};
+    std::uint64_t fills{0};
+    LatencyHistogram ack_latency;
+};
+
+//multi-client load tool: each client thread sends batches of framed orders
+//(10% cancels of its own live orders) and waits for the batch's acks before
+//sending the next, measuring send -> Accepted latency per order
+GatewayLoadResult runGatewayLoad(const std::string& path, std::size_t clients,
+                                 std::size_t orders_per_client, SymbolId num_symbols){
+    constexpr std::size_t kBatch = 64;
+    std::vector<GatewayLoadResult> results(clients);
+    std::vector<std::thread> threads;
+    for(std::size_t c = 0; c < clients; ++c){
+        threads.emplace_back([&, c](){
+            GatewayLoadResult& res = results[c];
+            GatewayClient client(path);
+            std::mt19937_64 rng(1000 + c);
+            std::uniform_int_distribution<int> side_dist(0, 1);
+            std::uniform_int_distribution<int> price_dist(95, 105);
+            std::uniform_int_distribution<int> qty_dist(1, 100);
+            std::uniform_int_distribution<SymbolId> sym_dist(0, num_symbols - 1);
+
+            //per client order id: 0 unsent, 1 awaiting ack, 2 live, 3 gone
+            std::vector<std::uint8_t> state(orders_per_client + 1, 0);
+            std::vector<std::int64_t> sent_ns(orders_per_client + 1, 0);
+            std::vector<Qty> open(orders_per_client + 1, 0);
+            std::vector<WireRequest> frames;
+            std::vector<WireReport> reports;
+            std::vector<std::int64_t> live;
+            std::int64_t next_id = 1;
+            std::size_t awaiting = 0;
+
+            for(std::size_t sent = 0; sent < orders_per_client;){
+                frames.clear();
+                while(frames.size() < kBatch && sent < orders_per_client){
+                    ++sent;
+                    if(!live.empty() && rng() % 10 == 0){
+                        std::size_t k = rng() % live.size();
+                        const std::int64_t id = live[k];
+                        live[k] = live.back();
+                        live.pop_back();
+                        if(state[id] != 2){continue;}
+                        frames.push_back(WireRequest{WireType::Cancel, Side::Buy, TimeInForce::GFD, 0, 0, id, 0, 0});
+                        ++res.cancels;
+                        continue;
+                    }
+                    const std::int64_t id = next_id++;
+                    const Side side = side_dist(rng) == 0 ? Side::Buy : Side::Sell;
+                    const Qty qty = qty_dist(rng);
+                    frames.push_back(WireRequest{WireType::NewLimit, side, TimeInForce::GFD, 0, sym_dist(rng),
+                                                 id, price_dist(rng), qty});
+                    state[id] = 1;
+                    open[id] = qty;
+                    sent_ns[id] = latencyNowNs();
+                    ++awaiting;
+                    ++res.orders;
+                }
+                client.send(frames.data(), frames.size());
+
+                while(awaiting > 0){
+                    reports.clear();
+                    client.receive(reports);
+                    const std::int64_t now = latencyNowNs();
+                    for(const WireReport& r: reports){
+                        const std::int64_t id = r.order_id;
+                        if(id <= 0 || id >= static_cast<std::int64_t>(state.size())){continue;}
+                        switch(r.type){
+                        case ReportType::Accepted:
+                            res.ack_latency.record(now - sent_ns[id]);
+                            state[id] = 2;
+                            live.push_back(id);
+                            --awaiting;
+                            break;
+                        case ReportType::Fill:
+                            ++res.fills;
+                            open[id] -= r.qty;
+                            if(open[id] <= 0){state[id] = 3;}
+                            break;
+                        case ReportType::Done:
+                            state[id] = 3;
+                            break;
+                        case ReportType::Rejected:
+                            if(state[id] == 1){--awaiting; state[id] = 3;}
+                            break;
+                        default:
+                            break;
+                        }
+                    }
+                }
+            }
+        });
+    }
+    for(auto& t: threads){t.join();}
+
+    GatewayLoadResult total;
+    for(const auto& r: results){
+        total.orders += r.orders;
+        total.cancels += r.cancels;
+        total.fills += r.fills;
+        total.ack_latency.merge(r.ack_latency);
+    }
+    return total;
+}
+
+void printGatewayLoad(const GatewayLoadResult& r, std::size_t clients, double seconds){
+    std::cout << "clients=" << clients << " orders=" << r.orders << " cancels=" << r.cancels
+              << " fills=" << r.fills << " seconds=" << seconds
+              << " orders/s=" << static_cast<std::uint64_t>(r.orders / seconds) << "\n";
+    std::cout << "ack latency: ";
+    printLatency(std::cout, "send->accepted", r.ack_latency);
+    std::cout << "\n";
+}
+
+//engine + gateway in one process, load tool clients on separate threads
+void runGatewayBench(std::size_t clients, std::size_t orders_per_client){
+    using namespace matching;
+    constexpr SymbolId kSymbols = 4;
+    AsyncMatchingEngine async_eng([](const Trade&){});
+    for(SymbolId s = 0; s < kSymbols; ++s){async_eng.engine().resolveSymbol("GW" + std::to_string(s));}
+
+    const std::string path = "/tmp/orderbook-gw-" + std::to_string(::getpid()) + ".sock";
+    SocketGateway gateway(async_eng, path);
+    gateway.start();
+
+    auto t0 = std::chrono::steady_clock::now();
+    GatewayLoadResult r = runGatewayLoad(path, clients, orders_per_client, kSymbols);
+    auto t1 = std::chrono::steady_clock::now();
+
+    //let disconnect cancels drain before reading the per-connection stats
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    gateway.stop();
+    async_eng.stop();
+
+    std::cout << "\n--- Gateway benchmark (" << path << ") ---\n";
+    printGatewayLoad(r, clients, std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / 1e9);
+    std::size_t i = 0;
+    for(const ConnectionStats& st: gateway.connectionStats()){
+        std::cout << "session " << i++ << " requests=" << st.requests << " accepted=" << st.accepted
+                  << " fills=" << st.fills << " rejects=" << st.rejects << " reports=" << st.reports
+                  << " bytes_in=" << st.bytes_in << " bytes_out=" << st.bytes_out << "\n";
+    }
+}
+
+//standalone gateway: serves until stdin closes or "q"
+void runGatewayServer(const std::string& path, const std::vector<std::string>& symbols, const std::string& journal,
+                      const std::string& replicate){
+    using namespace matching;
+    std::optional<ReplicationPublisher> standby_feed;
+    AsyncMatchingEngine async_eng([](const Trade&){});
+    if(!journal.empty() && !async_eng.journalTo(journal)){
+        std::cerr << "ERROR: cannot open journal: " << journal << "\n";
+        return;
+    }
+    if(!replicate.empty()){async_eng.replicateTo(standby_feed.emplace(replicate));}
+    for(const auto& name: symbols){
+        std::cout << name << " = " << async_eng.engine().resolveSymbol(name) << "\n";
+    }
+    SocketGateway gateway(async_eng, path);
+    gateway.start();
+    std::cout << "gateway listening on " << path << " (q to quit)\n";
+    std::string line;
+    while(std::getline(std::cin, line) && trim(line) != "q"){}
+    gateway.stop();
+    async_eng.stop();
+    if(standby_feed){printReplication(*standby_feed, async_eng.engine());}
+}
+//one shared-memory client process: batches of 64 orders (10% cancels of its
+//live orders), each batch acked before the next; prints its own result line
+void runShmClient(const std::string& name, std::size_t orders, std::uint64_t seed){
+    ShmClientSession session(name);
+    BasicAsyncOrderGateway<ShmClientSession> gw(session);
+    std::optional<SymbolId> symbol;
+    while(!(symbol = session.symbol("SHM0"))){std::this_thread::yield();}
+
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<int> price_dist(95, 105);
+    std::uniform_int_distribution<int> qty_dist(1, 100);
+    std::vector<std::int64_t> sent_ns(orders + 1, 0);
+    std::vector<std::uint8_t> live_flag(orders + 1, 0);
+    std::vector<OrderId> live;
+    LatencyHistogram ack;
+    std::uint64_t fills = 0;
+    std::size_t awaiting = 0;
+    const UserId user = static_cast<UserId>(1000 + session.slot());
+
+    auto on_report = [&](const ExecReport& r){
+        const OrderId id = r.client_id;
+        if(id <= 0 || id > static_cast<OrderId>(orders)){return;}
+        switch(r.type){
+        case ReportType::Accepted:
+            ack.record(latencyNowNs() - sent_ns[id]);
+            live_flag[id] = 1;
+            live.push_back(id);
+            --awaiting;
+            break;
+        case ReportType::Rejected:
+            if(sent_ns[id] != 0 && live_flag[id] == 0){--awaiting;}
+            live_flag[id] = 0;
+            break;
+        case ReportType::Fill:
+            ++fills;
+            break;
+        case ReportType::Done:
+            live_flag[id] = 0;
+            break;
+        default:
+            break;
+        }
+    };
+
+    const auto t0 = std::chrono::steady_clock::now();
+    std::size_t sent = 0;
+    std::uint64_t cancels = 0;
+    while(sent < orders){
+        for(int k = 0; k < 64 && sent < orders; ++k){
+            if(!live.empty() && rng() % 10 == 0){
+                const std::size_t i = rng() % live.size();
+                const OrderId id = live[i];
+                live[i] = live.back();
+                live.pop_back();
+                if(live_flag[id] && gw.cancel(*symbol, id)){++cancels;}
+                continue;
+            }
+            const Side side = rng() & 1 ? Side::Buy : Side::Sell;
+            const auto at = latencyNowNs();
+            const OrderId id = gw.newLimit(*symbol, user, side, price_dist(rng), qty_dist(rng));
+            sent_ns[id] = at;
+            ++awaiting;
+            ++sent;
+        }
+        while(awaiting > 0){
+            if(gw.poll(on_report) == 0){std::this_thread::yield();}
+        }
+        session.heartbeat();
+    }
+    const double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - t0).count() / 1e9;
+
+    std::ostringstream os;
+    os << "client slot=" << session.slot() << " pid=" << ::getpid() << " orders=" << sent
+       << " cancels=" << cancels << " fills=" << fills
+       << " orders/s=" << static_cast<std::uint64_t>(sent / seconds) << " ";
+    printLatency(os, "ack", ack);
+    os << "\n";
+    const std::string line = os.str();
+    [[maybe_unused]] auto n = ::write(STDOUT_FILENO, line.data(), line.size());
+}
+
+//engine in this process, clients in forked processes that only map the segment
+void runShmBench(std::size_t clients, std::size_t orders){
+    const std::string name = "/orderbook-shm-" + std::to_string(::getpid());
+    ShmOrderEntry entry(name, static_cast<std::uint32_t>(clients));
+    std::cout.flush();
+
+    //fork before any thread exists; children wait for the symbol directory
+    std::vector<pid_t> children;
+    for(std::size_t c = 0; c < clients; ++c){
+        const pid_t pid = ::fork();
+        if(pid == 0){
+            int rc = 0;
+            try{runShmClient(name, orders, 2000 + c);}
+            catch(const std::exception& e){std::cerr << e.what() << "\n"; rc = 1;}
+            ::_exit(rc);
+        }
+        children.push_back(pid);
+    }
+
+    AsyncMatchingEngine async_eng([](const Trade&){});
+    async_eng.engine().resolveSymbol("SHM0");
+    async_eng.attach(entry);
+    const auto t0 = std::chrono::steady_clock::now();
+    entry.publishSymbols(async_eng.engine());
+    for(pid_t pid: children){::waitpid(pid, nullptr, 0);}
+    const double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - t0).count() / 1e9;
+    //the engine cancels what the exited clients left resting
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    async_eng.stop();
+
+    const TopOfBook tob = async_eng.engine().topOfBook(0);
+    std::cout << "\n--- Shared-memory order entry (" << name << ") ---\n"
+              << "clients=" << clients << " orders=" << clients * orders << " seconds=" << seconds
+              << " orders/s=" << static_cast<std::uint64_t>(clients * orders / seconds)
+              << " book empty after disconnect=" << (!tob.best_bid && !tob.best_ask ? "yes" : "no") << "\n";
 }
 
+//engine serving external client processes until stdin closes or "q"
+void runShmServer(const std::string& name, const std::vector<std::string>& symbols, const std::string& journal,
+                  const std::string& replicate){
+    ShmOrderEntry entry(name, ShmControl::kMaxSlots, 1 << 14, 1'000'000'000);
+    std::optional<ReplicationPublisher> standby_feed;
+    AsyncMatchingEngine async_eng([](const Trade&){});
+    if(!journal.empty() && !async_eng.journalTo(journal)){
+        std::cerr << "ERROR: cannot open journal: " << journal << "\n";
+        return;
+    }
+    if(!replicate.empty()){async_eng.replicateTo(standby_feed.emplace(replicate));}
+    for(const auto& s: symbols){std::cout << s << " = " << async_eng.engine().resolveSymbol(s) << "\n";}
+    entry.publishSymbols(async_eng.engine());
+    async_eng.attach(entry);
+    std::cout << "order entry segment " << name << " (q to quit)\n";
+    std::string line;
+    while(std::getline(std::cin, line) && trim(line) != "q"){}
+    async_eng.stop();
+    if(standby_feed){printReplication(*standby_feed, async_eng.engine());}
+}
+
+//hot standby: follows a --replicate primary, printing its lag once a second.
+//When the primary stops or dies it reports the takeover point and then serves
+//order lines from stdin on the replicated books
+void runStandby(const std::string& name, std::int64_t primary_timeout_ms){
+    std::uint64_t trades = 0;
+    std::unique_ptr<HotStandby> standby;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(!standby){
+        try{
+            standby = std::make_unique<HotStandby>(name, primary_timeout_ms * 1'000'000,
+                                                   [&](const Trade&){++trades;});
+        }catch(const std::exception& ex){
+            //the primary may not have created the segment yet
+            if(std::chrono::steady_clock::now() > deadline){
+                std::cerr << "ERROR: " << ex.what() << "\n";
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    std::cout << "standby following " << name << " (primary pid " << standby->primaryPid() << ")\n";
+
+    auto next_report = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while(standby->state() == StandbyState::Following){
+        if(standby->poll() == 0){std::this_thread::yield();}
+        if(std::chrono::steady_clock::now() >= next_report){
+            next_report += std::chrono::seconds(1);
+            std::cout << "applied=" << standby->applied() << " lag=" << standby->lag()
+                      << " lag_us=" << standby->lagNs() / 1000 << " hashes_ok=" << standby->hashesVerified() << "\n";
+        }
+    }
+
+    MatchingEngine& engine = standby->engine();
+    std::cout << "standby " << standbyStateName(standby->state()) << " at seq " << standby->applied()
+              << " trades=" << trades << " hashes_ok=" << standby->hashesVerified()
+              << " hashes_missed=" << standby->hashesMissed()
+              << " state_hash=" << hex64(engineStateHash(engine)) << "\n";
+    if(standby->state() != StandbyState::PrimaryLost && standby->state() != StandbyState::PrimaryClosed){return;}
+
+    std::cout << "taking over: order lines on stdin (q to quit)\n";
+    std::string line;
+    while(std::getline(std::cin, line) && trim(line) != "q"){
+        Event e{};
+        if(!parseLine(trim(line), e)){continue;}
+        const OrderId id = engine.processInternal(engine.toInternal(e));
+        const TopOfBook tob = engine.topOfBook(e.symbol);
+        std::cout << "ACK id=" << id << " " << e.symbol
+                  << " bid=" << (tob.best_bid ? std::to_string(*tob.best_bid) : "none")
+                  << " ask=" << (tob.best_ask ? std::to_string(*tob.best_ask) : "none") << "\n";
+    }
+}
+#endif
+
 int main(int argc, char** argv){
     using namespace matching;
 
+    //"--journal path" anywhere after the mode records a timed journal and
+    //"--replicate name" feeds a hot standby (async modes)
+    std::string journal;
+    std::string replicate;
+    for(int i = 2; i + 1 < argc;){
+        const std::string arg = argv[i];
+        if(arg != "--journal" && arg != "--replicate"){
+            ++i;
+            continue;
+        }
+        (arg == "--journal" ? journal : replicate) = argv[i + 1];
+        std::copy(argv + i + 2, argv + argc, argv + i);
+        argc -= 2;
+    }
+
     if(argc >= 2 && std::string(argv[1]) == "--mm-demo"){
         runMarketMakerDemo();
         return 0;
     }
 
+    if(argc >= 2 && std::string(argv[1]) == "--mm-fleet"){
+        std::size_t num_symbols = argc >= 3 ? std::stoul(argv[2]) : 2000;
+        std::size_t levels = argc >= 4 ? std::stoul(argv[3]) : 1;
+        runMarketMakerFleet(num_symbols, 200, std::max<std::size_t>(1, levels));
+        return 0;
+    }
+
+    if(argc >= 2 && std::string(argv[1]).rfind("--gateway", 0) == 0){
+        #if defined(__linux__)
+        const std::string mode = argv[1];
+        if(mode == "--gateway" && argc >= 3){
+            runGatewayServer(argv[2], std::vector<std::string>(argv + 3, argv + argc), journal, replicate);
+        }
+        else if(mode == "--gateway-load" && argc >= 3){
+            std::size_t clients = argc >= 4 ? std::stoul(argv[3]) : 4;
+            std::size_t orders = argc >= 5 ? std::stoul(argv[4]) : 100000;
+            SymbolId symbols = argc >= 6 ? static_cast<SymbolId>(std::stoul(argv[5])) : 1;
+            auto t0 = std::chrono::steady_clock::now();
+            GatewayLoadResult r = runGatewayLoad(argv[2], clients, orders, std::max<SymbolId>(1, symbols));
+            auto t1 = std::chrono::steady_clock::now();
+            printGatewayLoad(r, clients, std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / 1e9);
+        }
+        else if(mode == "--gateway-bench"){
+            std::size_t clients = argc >= 3 ? std::stoul(argv[2]) : 4;
+            std::size_t orders = argc >= 4 ? std::stoul(argv[3]) : 100000;
+            runGatewayBench(clients, orders);
+        }
+        #else
+        std::cerr << "socket gateway requires Linux (epoll)\n";
+        #endif
+        return 0;
+    }
+
+    if(argc >= 2 && std::string(argv[1]).rfind("--shm-", 0) == 0){
+        #if defined(__linux__)
+        const std::string mode = argv[1];
+        if(mode == "--shm-serve" && argc >= 3){
+            runShmServer(argv[2], std::vector<std::string>(argv + 3, argv + argc), journal, replicate);
+        }
+        else if(mode == "--shm-bench"){
+            std::size_t clients = argc >= 3 ? std::stoul(argv[2]) : 4;
+            std::size_t orders = argc >= 4 ? std::stoul(argv[3]) : 200000;
+            runShmBench(std::clamp<std::size_t>(clients, 1, ShmControl::kMaxSlots), orders);
+        }
+        #else
+        std::cerr << "shared-memory order entry requires Linux\n";
+        #endif
+        return 0;
+    }
+
+    if(argc >= 2 && std::string(argv[1]) == "--log-bench"){
+        std::size_t records = argc >= 3 ? std::stoul(argv[2]) : 5000000;
+        runLogBench(records, argc >= 4 ? argv[3] : ".");
+        return 0;
+    }
+
+    if(argc >= 2 && std::string(argv[1]) == "--mm-coro"){
+        runCoroutineStrategy(2000);
+        return 0;
+    }
+
+    if(argc >= 3 && std::string(argv[1]) == "--standby"){
+        #if defined(__linux__)
+        runStandby(argv[2], argc >= 4 ? std::stoll(argv[3]) : 0);
+        #else
+        std::cerr << "hot standby requires Linux\n";
+        #endif
+        return 0;
+    }
+
+    if(argc >= 2 && std::string(argv[1]) == "--mm-async"){
+        std::size_t num_strategies = argc >= 3 ? std::stoul(argv[2]) : 2;
+        runAsyncMarketMakers(std::max<std::size_t>(1, num_strategies), 2000, journal, replicate);
+        return 0;
+    }
+
+    if(argc >= 3 && std::string(argv[1]) == "--backtest"){
+        runBacktestMode(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+        return 0;
+    }
+
+    if(argc >= 3 && std::string(argv[1]) == "--simulate"){
+        LatencyModel model{};
+        if(argc >= 4){model.order_entry_ns = std::stoll(argv[3]);}
+        if(argc >= 5){model.market_data_ns = std::stoll(argv[4]);}
+        if(argc >= 6){model.engine_ns = std::stoll(argv[5]);}
+        runSimulateMode(argv[2], model);
+        return 0;
+    }
+
+    if(argc >= 4 && std::string(argv[1]) == "--sweep"){
+        unsigned threads = argc >= 5 ? static_cast<unsigned>(std::stoul(argv[4])) : 0;
+        runSweepMode(argv[2], argv[3], threads);
+        return 0;
+    }
+
+    if(argc >= 4 && std::string(argv[1]) == "--convert"){
+        runConvert(argv[2], argv[3], argc >= 5 && std::string(argv[4]) == "--raw");
+        return 0;
+    }
+
+    if(argc >= 4 && std::string(argv[1]) == "--checkpoints"){
+        runCheckpoints(argv[2], argv[3], argc >= 5 ? std::stoull(argv[4]) : 1000000);
+        return 0;
+    }
+
+    if(argc >= 5 && std::string(argv[1]) == "--book-at"){
+        runBookAt(argv[2], argv[3], std::stoull(argv[4]), argc >= 6 ? argv[5] : "");
+        return 0;
+    }
+
+    if(argc >= 3 && std::string(argv[1]) == "--journal-info"){
+        runJournalInfo(argv[2]);
+        return 0;
+    }
+
+    if(argc >= 3 && std::string(argv[1]) == "--bars"){
+        runBars(argv[2], argc >= 4 ? std::stoll(argv[3]) : 1000, argc >= 5 ? argv[4] : "");
+        return 0;
+    }
+
+    if(argc >= 3 && std::string(argv[1]) == "--replay-paced"){
+        const std::string speed = argc >= 4 ? argv[3] : "1";
+        runPacedReplay(argv[2], speed == "max" ? 0.0 : std::stod(speed));
+        return 0;
+    }
+
     if(argc >= 3 && std::string(argv[1]) == "--replay"){
-        runReplay(argv[2]);
+        std::uint64_t checkpoint_every = 0;
+        if(argc >= 5 && std::string(argv[3]) == "--checkpoint"){checkpoint_every = std::stoull(argv[4]);}
+        runReplay(argv[2], checkpoint_every);
         return 0;
     }
 
-    MatchingEngine engine([](const Trade& t){
-        std::cout << "TRADE symbol=" << t.symbol_name
+    MatchingEngine engine([&engine](const Trade& t){
+        std::cout << "TRADE symbol=" << engine.symbolName(t.symbol_id)
                   << " px="  << t.price
                   << " qty=" << t.qty
                   << " buy=" << t.buy_id
@@ -556,8 +1893,8 @@ int main(int argc, char** argv){
         //replace test (qux)
     {
         std::cout << "\n--- Replace test (QUX) ---\n";
-        MatchingEngine eng2([](const Trade& t) {
-            std::cout << "TRADE symbol=" << t.symbol_name
+        MatchingEngine eng2([&eng2](const Trade& t) {
+            std::cout << "TRADE symbol=" << eng2.symbolName(t.symbol_id)
                       << " px="  << t.price
                       << " qty=" << t.qty
                       << " buy=" << t.buy_id
@@ -587,6 +1924,46 @@ int main(int argc, char** argv){
                   << "\n";
     }
 
+        //aggressor user of crossing replace / amend (quy)
+    {
+        std::cout << "\n--- Replace/Amend aggressor test (QUY) ---\n";
+        std::vector<Trade> trades;
+        MatchingEngine eng3([&trades](const Trade& t){trades.push_back(t);});
+
+        eng3.newLimit("QUY", UserId{7}, Side::Sell, 100, 20);
+        OrderId b1 = eng3.newLimit("QUY", UserId{8}, Side::Buy, 98, 5);
+        OrderId b2 = eng3.newLimit("QUY", UserId{9}, Side::Buy, 97, 5);
+
+        Event r{};
+        r.type = EventType::Replace;
+        r.symbol = "QUY";
+        r.id = b1;
+        r.side = Side::Buy;
+        r.price = 100;
+        r.qty = 5;
+        r.user_id = UserId{8};
+        eng3.process(r);
+
+        Event a{};
+        a.type = EventType::Amend;
+        a.symbol = "QUY";
+        a.id = b2;
+        a.price = 100;
+        a.qty = 5;
+        a.user_id = UserId{9};
+        eng3.process(a);
+
+        const UserId expected[] = {8, 9};
+        bool ok = trades.size() == 2;
+        for(std::size_t i = 0; i < trades.size(); ++i){
+            const Trade& t = trades[i];
+            std::cout << (i == 0 ? "Replace" : "Amend") << " trade buy_user=" << t.buy_user
+                      << " sell_user=" << t.sell_user << "\n";
+            ok = ok && i < 2 && t.aggressor == Side::Buy && t.buy_user == expected[i];
+        }
+        std::cout << "aggressor users " << (ok ? "OK" : "FAIL") << "\n";
+    }
+
     if (auto stats = engine.bookStats("FOO")) {
         std::cout << "FOO trades=" << stats->trade_count
                   << " volume="    << stats->traded_qty;
@@ -600,8 +1977,8 @@ int main(int argc, char** argv){
     {
         std::cout << "\n--- Async engine demo (ASY) ---\n";
 
-        AsyncMatchingEngine async_eng([](const Trade& t) {
-            std::cout << "ASY TRADE symbol=" << t.symbol_name
+        AsyncMatchingEngine async_eng([&async_eng](const Trade& t) {
+            std::cout << "ASY TRADE symbol=" << async_eng.engine().symbolName(t.symbol_id)
                       << " px="  << t.price
                       << " qty=" << t.qty
                       << " buy=" << t.buy_id
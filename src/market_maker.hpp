@@ -1,10 +1,14 @@
 #pragma once
 
 #include "matching_engine.hpp"
+#include "latency_stats.hpp"
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <limits>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace matching{
 
@@ -16,6 +20,12 @@ struct MarketMakerConfig{
     Price half_spread_ticks{1};
     Qty max_inventory{150};
     Qty inventory_skew_step{50};
+
+    //quote ladder: levels per side, spacing curve in ticks, size curve
+    std::size_t levels{1};
+    Price level_spacing_ticks{1};
+    Price spacing_growth_ticks{0};
+    Qty level_qty_step{0};
 };
 
 struct MarketMakerStats{
@@ -26,30 +36,52 @@ struct MarketMakerStats{
     std::uint64_t quote_updates{0};
 };
 
+//engine-facing methods are templated on the order gateway: MatchingEngine itself,
+//or anything with the same topOfBook/newLimit/cancel/amend SymbolId overloads
+//(e.g. the latency simulator's delayed gateway)
 class SimpleMarketMaker{
 public:
     explicit SimpleMarketMaker(MarketMakerConfig config)
-    : config_(std::move(config)) {}
+    : config_(std::move(config)) {
+        if(config_.levels == 0){config_.levels = 1;}
+        bids_.reserve(config_.levels);
+        asks_.reserve(config_.levels);
+        next_.reserve(config_.levels);
+        desired_.resize(config_.levels);
+    }
 
+    //resolve config symbol → SymbolId once; all later engine calls are id-based
+    void attach(MatchingEngine& engine){symbol_id_ = engine.resolveSymbol(config_.symbol);}
+
+    SymbolId symbolId() const{return symbol_id_;}
+    const MarketMakerConfig& config() const{return config_;}
     const MarketMakerStats& stats() const{return stats_;}
 
     bool onTrade(const Trade& trade){
-        if(trade.symbol_name == nullptr || config_.symbol != trade.symbol_name){return false;}
+        if(trade.symbol_id != symbol_id_){return false;}
 
         bool touched = false;
-        if(bid_.active && trade.buy_id == bid_.id){
-            applyBidFill(trade.price, trade.qty);
+        if(applyFill(bids_, trade.buy_id, trade.qty)){
+            accountFill(Side::Buy, trade.price, trade.qty);
             touched = true;
         }
-        if(ask_.active && trade.sell_id == ask_.id){
-            applyAskFill(trade.price, trade.qty);
+        if(applyFill(asks_, trade.sell_id, trade.qty)){
+            accountFill(Side::Sell, trade.price, trade.qty);
             touched = true;
         }
         return touched;
     }
 
-    void onTick(MatchingEngine& engine){
-        const TopOfBook tob = engine.topOfBook(config_.symbol);
+    //execution report for one of our own orders. Unlike onTrade it also counts
+    //fills on quotes we already dropped locally (cancel still in flight)
+    void onFill(Side side, OrderId id, Price price, Qty qty){
+        applyFill(side == Side::Buy ? bids_ : asks_, id, qty);
+        accountFill(side, price, qty);
+    }
+
+    template<typename Gateway>
+    void onTick(Gateway& engine){
+        const TopOfBook tob = engine.topOfBook(symbol_id_);
         const Price fair = estimateFairValue(tob);
         const Price skew = inventorySkewTicks();
 
@@ -69,21 +101,26 @@ public:
             desired_ask = desired_bid + 1;
         }
 
-        maintainQuote(engine, bid_, Side::Buy, quote_bid, desired_bid);
-        maintainQuote(engine, ask_, Side::Sell, quote_ask, desired_ask);
+        maintainLadder(engine, bids_, Side::Buy, quote_bid, desired_bid);
+        maintainLadder(engine, asks_, Side::Sell, quote_ask, desired_ask);
     }
 
-    void cancelAll(MatchingEngine& engine){
-        cancelQuote(engine, bid_);
-        cancelQuote(engine, ask_);
+    template<typename Gateway>
+    void cancelAll(Gateway& engine){
+        for(const ActiveQuote& q: bids_){engine.cancel(symbol_id_, q.id);}
+        for(const ActiveQuote& q: asks_){engine.cancel(symbol_id_, q.id);}
+        bids_.clear();
+        asks_.clear();
     }
 
-    long long markToMarket(const MatchingEngine& engine) const{
+    template<typename Gateway>
+    long long markToMarket(const Gateway& engine) const{
         return stats_.cash + static_cast<long long>(stats_.position) *
-            static_cast<long long>(estimateFairValue(engine.topOfBook(config_.symbol)));
+            static_cast<long long>(estimateFairValue(engine.topOfBook(symbol_id_)));
     }
 
-    void printStatus(const MatchingEngine& engine, std::ostream& os) const{
+    template<typename Gateway>
+    void printStatus(const Gateway& engine, std::ostream& os) const{
         os << "MM status symbol=" << config_.symbol
            << " position=" << stats_.position
            << " cash=" << stats_.cash
@@ -92,29 +129,38 @@ public:
            << " ask_fill_qty=" << stats_.ask_filled_qty
            << " quote_updates=" << stats_.quote_updates;
 
-        if(bid_.active){
-            os << " active_bid=" << bid_.price << "x" << bid_.remaining
-               << "(id=" << bid_.id << ")";
+        for(const ActiveQuote& q: bids_){
+            os << " active_bid=" << q.price << "x" << q.remaining
+               << "(id=" << q.id << ")";
         }
-        if(ask_.active){
-            os << " active_ask=" << ask_.price << "x" << ask_.remaining
-               << "(id=" << ask_.id << ")";
+        for(const ActiveQuote& q: asks_){
+            os << " active_ask=" << q.price << "x" << q.remaining
+               << "(id=" << q.id << ")";
         }
         os << "\n";
     }
 
 private:
     struct ActiveQuote{
-        bool active{false};
         OrderId id{0};
         Price price{0};
         Qty remaining{0};
     };
 
+    struct LevelTarget{
+        Price price{0};
+        Qty qty{0};
+    };
+
     MarketMakerConfig config_;
+    SymbolId symbol_id_{std::numeric_limits<SymbolId>::max()}; //unattached: matches no trade
     MarketMakerStats stats_;
-    ActiveQuote bid_;
-    ActiveQuote ask_;
+    //live quotes per side, best level first (bids descending, asks ascending)
+    std::vector<ActiveQuote> bids_;
+    std::vector<ActiveQuote> asks_;
+    //scratch reused every tick (no allocation after construction)
+    std::vector<ActiveQuote> next_;
+    std::vector<LevelTarget> desired_;
 
     Price estimateFairValue(const TopOfBook& tob) const{
         if(tob.mid_price){return *tob.mid_price;}
@@ -129,50 +175,228 @@ private:
         return static_cast<Price>(stats_.position / config_.inventory_skew_step);
     }
 
-    void maintainQuote(MatchingEngine& engine, ActiveQuote& quote, Side side,
-                       bool should_quote, Price desired_price){
-        if(!should_quote){
-            cancelQuote(engine, quote);
-            return;
+    //distance of level i from the top quote: gaps start at level_spacing_ticks
+    //and widen by spacing_growth_ticks per level
+    Price levelOffset(std::size_t i) const{
+        const Price n = static_cast<Price>(i);
+        return n * config_.level_spacing_ticks + config_.spacing_growth_ticks * n * (n - 1) / 2;
+    }
+
+    Qty levelQty(std::size_t i) const{
+        return std::max<Qty>(1, config_.quote_qty + static_cast<Qty>(i) * config_.level_qty_step);
+    }
+
+    //single merge pass over desired and active levels (both best-first):
+    //same price → keep or amend size in place, otherwise place or cancel
+    template<typename Gateway>
+    void maintainLadder(Gateway& engine, std::vector<ActiveQuote>& active, Side side,
+                        bool should_quote, Price top_price){
+        std::size_t n = 0;
+        if(should_quote){
+            const Price dir = side == Side::Buy ? -1 : 1;
+            for(std::size_t i = 0; i < config_.levels; ++i){
+                desired_[i] = LevelTarget{top_price + dir * levelOffset(i), levelQty(i)};
+            }
+            n = config_.levels;
+        }
+
+        next_.clear();
+        std::size_t i = 0, j = 0;
+        while(i < n || j < active.size()){
+            if(j < active.size() && i < n && active[j].price == desired_[i].price){
+                ActiveQuote q = active[j];
+                if(q.remaining != desired_[i].qty){
+                    OrderId id = engine.amend(symbol_id_, q.id, desired_[i].price, desired_[i].qty);
+                    if(id != 0){
+                        next_.push_back(ActiveQuote{id, desired_[i].price, desired_[i].qty});
+                        ++stats_.quote_updates;
+                    }
+                }
+                else{next_.push_back(q);}
+                ++i; ++j;
+            }
+            else if(j == active.size() || (i < n && isBetter(side, desired_[i].price, active[j].price))){
+                OrderId id = engine.newLimit(
+                    symbol_id_, config_.user_id, side, desired_[i].price,
+                    desired_[i].qty, TimeInForce::GFD);
+                if(id != 0){
+                    next_.push_back(ActiveQuote{id, desired_[i].price, desired_[i].qty});
+                    ++stats_.quote_updates;
+                }
+                ++i;
+            }
+            else{
+                engine.cancel(symbol_id_, active[j].id);
+                ++j;
+            }
+        }
+        active.swap(next_);
+    }
+
+    void accountFill(Side side, Price price, Qty qty){
+        const long long notional = static_cast<long long>(price) * static_cast<long long>(qty);
+        if(side == Side::Buy){
+            stats_.position += qty;
+            stats_.cash -= notional;
+            stats_.bid_filled_qty += qty;
+        }
+        else{
+            stats_.position -= qty;
+            stats_.cash += notional;
+            stats_.ask_filled_qty += qty;
+        }
+    }
+
+    static bool isBetter(Side side, Price a, Price b){
+        return side == Side::Buy ? a > b : a < b;
+    }
+
+    static bool applyFill(std::vector<ActiveQuote>& quotes, OrderId id, Qty qty){
+        for(auto it = quotes.begin(); it != quotes.end(); ++it){
+            if(it->id != id){continue;}
+            it->remaining -= qty;
+            if(it->remaining <= 0){quotes.erase(it);}
+            return true;
+        }
+        return false;
+    }
+};
+
+//symbols touched since the last flush, each listed once in mark order. Marks
+//made while a taken batch is processed go to the next batch
+class DirtySymbols{
+public:
+    void resize(std::size_t n){
+        if(n > marked_.size()){marked_.resize(n, 0);}
+    }
+
+    //true if newly marked
+    bool mark(SymbolId symbol){
+        if(marked_[symbol]){return false;}
+        marked_[symbol] = 1;
+        pending_.push_back(symbol);
+        return true;
+    }
+
+    bool empty() const{return pending_.empty();}
+
+    //moves the marked symbols into out (replacing its contents) and unmarks them
+    void take(std::vector<SymbolId>& out){
+        out.clear();
+        out.swap(pending_);
+        for(SymbolId symbol: out){marked_[symbol] = 0;}
+    }
+
+private:
+    std::vector<std::uint8_t> marked_;
+    std::vector<SymbolId> pending_;
+};
+
+//routes engine trades and book updates to makers through a dense
+//SymbolId → makers table (one vector index per event instead of broadcasting)
+//
+//event-driven quoting: trades and BBO changes only mark a symbol dirty; flush()
+//then requotes each dirty symbol once, so a burst of updates within one event
+//batch costs a single onTick per maker
+class MarketMakerRouter{
+public:
+    void attach(SimpleMarketMaker& maker, MatchingEngine& engine){
+        maker.attach(engine);
+        SymbolId sid = maker.symbolId();
+        if(sid >= by_symbol_.size()){
+            by_symbol_.resize(sid + 1);
+            dirty_.resize(sid + 1);
+            trigger_ns_.resize(sid + 1, 0);
         }
-        if(quote.active && quote.price == desired_price && quote.remaining == config_.quote_qty){
-            return;
+        by_symbol_[sid].push_back(&maker);
+        if(timing_){
+            latency_.resize(by_symbol_.size());
+            latency_[sid].push_back(std::make_unique<TickToTradeStats>());
         }
+        markDirty(sid); //quote on the first flush
+    }
 
-        cancelQuote(engine, quote);
-        OrderId id = engine.newLimit(
-            config_.symbol, config_.user_id, side, desired_price,
-            config_.quote_qty, TimeInForce::GFD);
-        if(id != 0){
-            quote.active = true;
-            quote.id = id;
-            quote.price = desired_price;
-            quote.remaining = config_.quote_qty;
-            ++stats_.quote_updates;
+    //tick-to-trade timing: each dirty mark stamps the symbol's trigger time and
+    //flush routes the makers' ops through a TimedGateway. Off by default
+    void enableLatencyStats(){
+        if(timing_){return;}
+        timing_ = true;
+        latency_.resize(by_symbol_.size());
+        for(std::size_t sid = 0; sid < by_symbol_.size(); ++sid){
+            while(latency_[sid].size() < by_symbol_[sid].size()){
+                latency_[sid].push_back(std::make_unique<TickToTradeStats>());
+            }
         }
     }
 
-    void cancelQuote(MatchingEngine& engine, ActiveQuote& quote){
-        if(!quote.active){return;}
-        engine.cancel(config_.symbol, quote.id);
-        quote = ActiveQuote{};
+    //nullptr unless timing is enabled and the maker is attached
+    const TickToTradeStats* latencyStats(const SimpleMarketMaker& maker) const{
+        if(!timing_){return nullptr;}
+        const SymbolId sid = maker.symbolId();
+        if(sid >= by_symbol_.size()){return nullptr;}
+        for(std::size_t i = 0; i < by_symbol_[sid].size(); ++i){
+            if(by_symbol_[sid][i] == &maker){return latency_[sid][i].get();}
+        }
+        return nullptr;
     }
 
-    void applyBidFill(Price price, Qty qty){
-        stats_.position += qty;
-        stats_.cash -= static_cast<long long>(price) * static_cast<long long>(qty);
-        stats_.bid_filled_qty += qty;
-        bid_.remaining -= qty;
-        if(bid_.remaining <= 0){bid_ = ActiveQuote{};}
+    //returns true if the trade filled a quote of any maker on that symbol
+    bool onTrade(const Trade& trade){
+        if(trade.symbol_id >= by_symbol_.size()){return false;}
+        bool touched = false;
+        for(SimpleMarketMaker* maker: by_symbol_[trade.symbol_id]){
+            touched |= maker->onTrade(trade);
+        }
+        if(touched){markDirty(trade.symbol_id);}
+        return touched;
     }
 
-    void applyAskFill(Price price, Qty qty){
-        stats_.position -= qty;
-        stats_.cash += static_cast<long long>(price) * static_cast<long long>(qty);
-        stats_.ask_filled_qty += qty;
-        ask_.remaining -= qty;
-        if(ask_.remaining <= 0){ask_ = ActiveQuote{};}
+    //hook for MatchingEngine::setBookUpdateCallback
+    void onBookUpdate(SymbolId symbol){
+        if(symbol < by_symbol_.size() && !by_symbol_[symbol].empty()){markDirty(symbol);}
+    }
+
+    //end of an event batch: requote every dirty symbol once. Book updates caused
+    //by the makers' own quotes mark the symbol dirty for the next batch
+    void flush(MatchingEngine& engine){
+        if(dirty_.empty()){return;}
+        dirty_.take(flushing_);
+        for(SymbolId sid: flushing_){
+            const auto& makers = by_symbol_[sid];
+            for(std::size_t i = 0; i < makers.size(); ++i){
+                if(timing_){
+                    TimedGateway<MatchingEngine> gw(engine, trigger_ns_[sid], *latency_[sid][i]);
+                    makers[i]->onTick(gw);
+                }
+                else{makers[i]->onTick(engine);}
+            }
+        }
+        flushing_.clear();
+    }
+
+    void onTick(MatchingEngine& engine){
+        for(auto& makers: by_symbol_){
+            for(SimpleMarketMaker* maker: makers){maker->onTick(engine);}
+        }
+    }
+
+    void cancelAll(MatchingEngine& engine){
+        for(auto& makers: by_symbol_){
+            for(SimpleMarketMaker* maker: makers){maker->cancelAll(engine);}
+        }
+    }
+
+private:
+    std::vector<std::vector<SimpleMarketMaker*>> by_symbol_;
+    DirtySymbols dirty_;
+    std::vector<SymbolId> flushing_;
+    bool timing_{false};
+    std::vector<std::int64_t> trigger_ns_; //first unhandled change per symbol
+    std::vector<std::vector<std::unique_ptr<TickToTradeStats>>> latency_; //parallel to by_symbol_
+
+    void markDirty(SymbolId symbol){
+        if(dirty_.mark(symbol) && timing_){trigger_ns_[symbol] = latencyNowNs();}
     }
 };
 
-}
+}
\ No newline at end of file
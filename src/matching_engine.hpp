@@ -1,6 +1,7 @@
 #pragma once
 
 #include "orderbook.hpp"
+#include "tsc_clock.hpp"
 #include <deque>
 #include <string>
 #include <optional>
@@ -16,7 +17,8 @@
 
 namespace matching{
 
-enum class EventType: std::uint8_t {NewLimit, NewMarket, Cancel, Replace, Stop};
+//Replace = cancel + new order; Amend = MatchingEngine::amend (keeps priority when it can)
+enum class EventType: std::uint8_t {NewLimit, NewMarket, Cancel, Replace, Stop, Amend};
 
 //external event: string symbol (for protocol / parsing layer)
 struct Event{
@@ -82,6 +84,8 @@ struct TopOfBook{
 class MatchingEngine{
 public:
     using TradeCallback = std::function<void(const Trade&)>;
+    //fired after an op that changed a book's best bid/ask price or size
+    using BookUpdateCallback = std::function<void(SymbolId)>;
 
     //internal callback: concrete type, devirtualized + inlinable
     struct InternalCallback{
@@ -91,7 +95,7 @@ public:
     using BookType = OrderBook<InternalCallback>;
 
     explicit MatchingEngine(TradeCallback cb = nullptr):
-        callback_(std::move(cb)){}
+        callback_(std::move(cb)){TscClock::calibrate();}
 
     //non-copyable, non-movable (InternalCallback stores `this`)
     MatchingEngine(const MatchingEngine&) = delete;
@@ -120,8 +124,26 @@ public:
     }
     #endif
 
+    //engine sequence: every input event applied (new, cancel, replace, amend;
+    //rejected ones included) gets the next number and one TscClock timestamp,
+    //which its trades carry. Trades are numbered separately without gaps, so a
+    //trade feed can detect loss and order trades across symbols. The event keeps
+    //the raw counter; it is converted to ns only where a timestamp is read
+    std::uint64_t lastEventSeq() const{return event_seq_;}
+    std::int64_t lastEventNs() const{
+        if(replay_ns_ != 0){return replay_ns_;}
+        return event_seq_ ? TscClock::toNs(event_ticks_) : 0;
+    }
+    std::uint64_t lastTradeSeq() const{return trade_seq_;}
+
+    //stamp the following events with a recorded time (journal replay) instead of
+    //the clock; 0 goes back to the clock
+    void setReplayTime(std::int64_t ns){replay_ns_ = ns;}
+
     void setMaxPosition(Qty limit){max_abs_position_ = limit;}
 
+    void setBookUpdateCallback(BookUpdateCallback cb){book_update_cb_ = std::move(cb);}
+
     #if MATCHING_ENABLE_USER_TRACKING
     void reserveOwnerMap(std::size_t n){owner_.reserve(n);}
     #else
@@ -133,7 +155,10 @@ public:
     const std::string& symbolName(SymbolId id) const{return symbols_.name(id);}
 
     //process external Event (string symbol → resolved internally)
-    void process(const Event& e){
+    OrderId process(const Event& e){return processInternal(toInternal(e));}
+
+    //resolves the symbol (creating it on first use)
+    InternalEvent toInternal(const Event& e){
         InternalEvent ie{};
         ie.symbol = symbols_.getOrCreate(e.symbol);
         ie.type = e.type;
@@ -143,37 +168,39 @@ public:
         ie.id = e.id;
         ie.tif = e.tif;
         ie.user_id = e.user_id;
-        processInternal(ie);
+        return ie;
     }
 
     //process internal event (hot path, no string allocation)
-    void processInternal(const InternalEvent& e){
+    //returns the id assigned to a new/replacement order, the cancelled id on a
+    //successful cancel, or 0
+    OrderId processInternal(const InternalEvent& e){
         switch(e.type){
         case EventType::NewLimit:
-            newLimit(e.symbol, e.user_id, e.side, e.price, e.qty, e.tif);
-            break;
+            return newLimit(e.symbol, e.user_id, e.side, e.price, e.qty, e.tif);
         case EventType::NewMarket:
-            newMarket(e.symbol, e.user_id, e.side, e.qty);
-            break;
+            return newMarket(e.symbol, e.user_id, e.side, e.qty);
         case EventType::Cancel:
-            cancel(e.symbol, e.id);
-            break;
+            return cancel(e.symbol, e.id) ? e.id : OrderId{0};
         case EventType::Replace:
             #if MATCHING_ENABLE_USER_TRACKING
             {
                 UserId user = e.user_id;
                 if(auto it = owner_.find(e.id); it != owner_.end()){user = it->second;}
-                OrderId newId = replace(e.symbol, e.id, e.side, e.price, e.qty, e.tif);
+                OrderId newId = replace(e.symbol, e.id, e.side, e.price, e.qty, e.tif, user);
                 if(newId != 0){owner_[newId] = user;}
                 owner_.erase(e.id);
+                return newId;
             }
             #else
-            replace(e.symbol, e.id, e.side, e.price, e.qty, e.tif);
+            return replace(e.symbol, e.id, e.side, e.price, e.qty, e.tif, e.user_id);
             #endif
-            break;
+        case EventType::Amend:
+            return amend(e.symbol, e.id, e.price, e.qty, e.user_id);
         case EventType::Stop:
             break;
         }
+        return 0;
     }
 
     //--- convenience overloads (string symbols) ---
@@ -193,26 +220,8 @@ public:
     //--- core SymbolId-based methods ---
 
     OrderId newLimit(SymbolId symbol, UserId user, Side side, Price price, Qty qty, TimeInForce tif = TimeInForce::GFD){
-        #if MATCHING_ENABLE_USER_TRACKING
-        if(!checkRisk(user, symbol, side, qty)){return 0;}
-        #endif
-
-        auto& book = getOrCreateBook(symbol);
-
-        #if MATCHING_ENABLE_USER_TRACKING
-        current_user_ = user;
-        current_side_ = side;
-        have_current_ = true;
-        #endif
-
-        OrderId id = book.addLimit(side, price, qty, tif);
-
-        #if MATCHING_ENABLE_USER_TRACKING
-        have_current_ = false;
-        if(id != 0){owner_[id] = user;}
-        #endif
-
-        return id;
+        beginEvent(user);
+        return addLimit(symbol, user, side, price, qty, tif);
     }
 
     OrderId newMarket(const std::string& symbol, Side side, Qty qty){
@@ -224,11 +233,13 @@ public:
     }
 
     OrderId newMarket(SymbolId symbol, UserId user, Side side, Qty qty){
+        beginEvent(user);
         #if MATCHING_ENABLE_USER_TRACKING
         if(!checkRisk(user, symbol, side, qty)){return 0;}
         #endif
 
         auto& book = getOrCreateBook(symbol);
+        const std::uint64_t bbo_before = book.bboSeq();
 
         #if MATCHING_ENABLE_USER_TRACKING
         current_user_ = user;
@@ -236,6 +247,7 @@ public:
         have_current_ = true;
         #endif
 
+        stampBarTime(book);
         OrderId id = book.addMarket(side, qty);
 
         #if MATCHING_ENABLE_USER_TRACKING
@@ -243,6 +255,8 @@ public:
         if(id != 0){owner_[id] = user;}
         #endif
 
+        notifyBookUpdate(symbol, book, bbo_before);
+
         return id;
     }
 
@@ -253,17 +267,55 @@ public:
     }
 
     bool cancel(SymbolId symbol, OrderId id){
-        if(symbol >= books_.size() || !books_[symbol]){return false;}
-        return books_[symbol]->cancel(id);
+        beginEvent();
+        return cancelOrder(symbol, id);
     }
 
     OrderId replace(const std::string& symbol, OrderId old_id, Side side, Price price, Qty qty, TimeInForce tif = TimeInForce::GFD){
         return replace(symbols_.getOrCreate(symbol), old_id, side, price, qty, tif);
     }
 
-    OrderId replace(SymbolId symbol, OrderId old_id, Side side, Price price, Qty qty, TimeInForce tif = TimeInForce::GFD){
-        cancel(symbol, old_id);
-        return newLimit(symbol, UserId{1}, side, price, qty, tif);
+    //one input event: the cancel and the new order share its sequence number;
+    //user is the sender, the aggressor of any trades the new order makes
+    OrderId replace(SymbolId symbol, OrderId old_id, Side side, Price price, Qty qty,
+                    TimeInForce tif = TimeInForce::GFD, UserId user = UserId{1}){
+        beginEvent(user);
+        cancelOrder(symbol, old_id);
+        return addLimit(symbol, user, side, price, qty, tif);
+    }
+
+    //amend a resting order (see OrderBook::amend): returns the resulting id,
+    //which equals old_id when the amend kept queue priority, or 0 if not found.
+    //user is the sender (with user tracking, the order's owner wins)
+    OrderId amend(SymbolId symbol, OrderId old_id, Price price, Qty qty, UserId user = UserId{1}){
+        beginEvent(user);
+        if(symbol >= books_.size() || !books_[symbol]){return 0;}
+        auto& book = *books_[symbol];
+        const std::uint64_t bbo_before = book.bboSeq();
+
+        #if MATCHING_ENABLE_USER_TRACKING
+        if(auto it = owner_.find(old_id); it != owner_.end()){user = it->second;}
+        event_user_ = user;
+        if(const Order* o = book.findOrder(old_id)){
+            current_user_ = user;
+            current_side_ = o->side;
+            have_current_ = true;
+        }
+        #endif
+
+        stampBarTime(book);
+        OrderId id = book.amend(old_id, price, qty);
+
+        #if MATCHING_ENABLE_USER_TRACKING
+        have_current_ = false;
+        if(id != old_id){
+            owner_.erase(old_id);
+            if(id != 0){owner_[id] = user;}
+        }
+        #endif
+
+        notifyBookUpdate(symbol, book, bbo_before);
+        return id;
     }
 
     TopOfBook topOfBook(const std::string& symbol) const{
@@ -290,6 +342,20 @@ public:
         return books_[*sid].get();
     }
 
+    const BookType* findBook(SymbolId symbol) const{
+        if(symbol >= books_.size()){return nullptr;}
+        return books_[symbol].get();
+    }
+
+    //replaces the symbol's book with a snapshot of its resting orders (as listed
+    //by forEachOrder); stats, bars and signals restart empty
+    void restoreBook(SymbolId symbol, OrderId next_id, const std::vector<Order>& orders){
+        if(symbol < books_.size()){books_[symbol].reset();}
+        auto& book = getOrCreateBook(symbol);
+        for(const Order& o: orders){book.restoreOrder(o);}
+        book.restoreNextOrderId(next_id);
+    }
+
     std::optional<BookStats> bookStats(const std::string& symbol) const{
         auto sid = symbols_.find(symbol);
         if(!sid || *sid >= books_.size() || !books_[*sid]){return std::nullopt;}
@@ -301,11 +367,42 @@ public:
         return books_[symbol]->stats();
     }
 
+    std::optional<BookSignals> bookSignals(SymbolId symbol) const{
+        if(symbol >= books_.size() || !books_[symbol]){return std::nullopt;}
+        return books_[symbol]->signals();
+    }
+
+    //appends the symbol's retained bars to `out` (columnar, oldest first)
+    bool exportBars(SymbolId symbol, BarColumns& out) const{
+        if(symbol >= books_.size() || !books_[symbol]){return false;}
+        books_[symbol]->exportBars(out);
+        return true;
+    }
+
+    //applies to existing books (clearing their bars) and to books created later
+    void setBarConfig(const BarConfig& config){
+        bar_config_ = config;
+        for(auto& book: books_){
+            if(book){book->setBarConfig(config);}
+        }
+    }
+
+    //applies to existing books and to books created later
+    void setSignalConfig(const SignalConfig& config){
+        signal_config_ = config;
+        for(auto& book: books_){
+            if(book){book->setSignalConfig(config);}
+        }
+    }
+
     SymbolIndex& symbolIndex(){return symbols_;}
     const SymbolIndex& symbolIndex() const{return symbols_;}
 
 private:
     TradeCallback callback_;
+    BookUpdateCallback book_update_cb_;
+    SignalConfig signal_config_;
+    BarConfig bar_config_;
     SymbolIndex symbols_;
     //O(1) book lookup by SymbolId (index into vector)
     std::vector<std::unique_ptr<BookType>> books_;
@@ -324,6 +421,59 @@ private:
 
     Qty max_abs_position_ = static_cast<Qty>(1'000'000'000);
 
+    std::uint64_t event_seq_{0};
+    std::uint64_t trade_seq_{0};
+    std::uint64_t event_ticks_{0};
+    std::int64_t replay_ns_{0};
+    UserId event_user_{0}; //the aggressor of the event's trades
+
+    void beginEvent(UserId user = 0){
+        ++event_seq_;
+        event_ticks_ = TscClock::ticks();
+        event_user_ = user;
+    }
+
+    OrderId addLimit(SymbolId symbol, UserId user, Side side, Price price, Qty qty, TimeInForce tif){
+        #if MATCHING_ENABLE_USER_TRACKING
+        if(!checkRisk(user, symbol, side, qty)){return 0;}
+        #endif
+
+        auto& book = getOrCreateBook(symbol);
+        const std::uint64_t bbo_before = book.bboSeq();
+
+        #if MATCHING_ENABLE_USER_TRACKING
+        current_user_ = user;
+        current_side_ = side;
+        have_current_ = true;
+        #endif
+
+        stampBarTime(book);
+        OrderId id = book.addLimit(side, price, qty, tif);
+
+        #if MATCHING_ENABLE_USER_TRACKING
+        have_current_ = false;
+        if(id != 0){owner_[id] = user;}
+        #endif
+
+        notifyBookUpdate(symbol, book, bbo_before);
+
+        return id;
+    }
+
+    //bars are bucketed by event time, not by when the book happens to match
+    void stampBarTime(BookType& book) const{
+        if(bar_config_.capacity != 0){book.setBarTime(lastEventNs());}
+    }
+
+    bool cancelOrder(SymbolId symbol, OrderId id){
+        if(symbol >= books_.size() || !books_[symbol]){return false;}
+        auto& book = *books_[symbol];
+        const std::uint64_t bbo_before = book.bboSeq();
+        bool ok = book.cancel(id);
+        notifyBookUpdate(symbol, book, bbo_before);
+        return ok;
+    }
+
     BookType& getOrCreateBook(SymbolId symbol){
         if(symbol >= books_.size()){
             books_.resize(symbol + 1);
@@ -331,16 +481,28 @@ private:
         if(!books_[symbol]){
             books_[symbol] = std::make_unique<BookType>(
                 symbol, symbols_.nameCStr(symbol), InternalCallback{this});
+            books_[symbol]->setSignalConfig(signal_config_);
+            if(bar_config_.capacity != 0){books_[symbol]->setBarConfig(bar_config_);}
         }
         return *books_[symbol];
     }
 
-    void handleTrade(const Trade& t){
+    void notifyBookUpdate(SymbolId symbol, const BookType& book, std::uint64_t bbo_before){
+        if(book_update_cb_ && book.bboSeq() != bbo_before){book_update_cb_(symbol);}
+    }
+
+    void handleTrade(Trade t){
+        t.seq = ++trade_seq_;
+        t.event_seq = event_seq_;
+        t.ts_ns = lastEventNs();
+        (t.aggressor == Side::Buy ? t.buy_user : t.sell_user) = event_user_;
+
         #if MATCHING_ENABLE_USER_TRACKING
         auto itB = owner_.find(t.buy_id);
         auto itS = owner_.find(t.sell_id);
 
         if(itB != owner_.end()){
+            t.buy_user = itB->second;
             auto& pos = user_positions_[itB->second][t.symbol_id];
             pos.position += t.qty;
             pos.traded_volume += t.qty;
@@ -352,6 +514,7 @@ private:
         }
 
         if(itS != owner_.end()){
+            t.sell_user = itS->second;
             auto& pos = user_positions_[itS->second][t.symbol_id];
             pos.position -= t.qty;
             pos.traded_volume += t.qty;
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace matching{
+
+//fixed-size free-list pool owned by a single OrderBook: no locking, and books
+//on different threads never share allocator state. The block size is fixed by
+//the first allocation (the container's node type); other sizes go to operator new
+class NodePool{
+public:
+    NodePool() = default;
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    void* allocate(std::size_t bytes){
+        if(block_size_ == 0){block_size_ = roundUp(bytes);}
+        if(roundUp(bytes) != block_size_){return ::operator new(bytes);}
+        if(!free_){grow();}
+        FreeNode* n = free_;
+        free_ = n->next;
+        return n;
+    }
+
+    void deallocate(void* p, std::size_t bytes) noexcept{
+        if(roundUp(bytes) != block_size_){::operator delete(p); return;}
+        FreeNode* n = static_cast<FreeNode*>(p);
+        n->next = free_;
+        free_ = n;
+    }
+
+private:
+    struct FreeNode{FreeNode* next;};
+    static constexpr std::size_t kAlign = alignof(std::max_align_t);
+
+    std::vector<std::unique_ptr<std::byte[]>> chunks_;
+    FreeNode* free_{nullptr};
+    std::size_t block_size_{0};
+    std::size_t next_chunk_blocks_{256};
+
+    static std::size_t roundUp(std::size_t bytes){
+        if(bytes < sizeof(FreeNode)){bytes = sizeof(FreeNode);}
+        return (bytes + kAlign - 1) / kAlign * kAlign;
+    }
+
+    //chunks double in size (capped) so large books allocate rarely
+    void grow(){
+        const std::size_t blocks = next_chunk_blocks_;
+        if(next_chunk_blocks_ < (1u << 16)){next_chunk_blocks_ *= 2;}
+        chunks_.emplace_back(new std::byte[blocks * block_size_]);
+        std::byte* base = chunks_.back().get();
+        for(std::size_t i = blocks; i-- > 0;){
+            FreeNode* n = reinterpret_cast<FreeNode*>(base + i * block_size_);
+            n->next = free_;
+            free_ = n;
+        }
+    }
+};
+
+//stateful allocator handing out NodePool blocks; propagates on move/swap so
+//containers relocated inside a flat_map keep pointing at the same pool
+template<typename T>
+struct PoolAllocator{
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    NodePool* pool;
+
+    explicit PoolAllocator(NodePool* p) noexcept: pool(p){}
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U>& other) noexcept: pool(other.pool){}
+
+    T* allocate(std::size_t n){return static_cast<T*>(pool->allocate(n * sizeof(T)));}
+    void deallocate(T* p, std::size_t n) noexcept{pool->deallocate(p, n * sizeof(T));}
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U>& other) const noexcept{return pool == other.pool;}
+    template<typename U>
+    bool operator!=(const PoolAllocator<U>& other) const noexcept{return pool != other.pool;}
+};
+
+}
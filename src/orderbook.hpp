@@ -7,9 +7,11 @@
 #include <string>
 #include <limits>
 #include <algorithm>
+#include <vector>
 #include <iostream>
+#include <type_traits>
+#include "node_pool.hpp"
 #include <boost/container/flat_map.hpp>
-#include <boost/pool/pool_alloc.hpp>
 #include <boost/unordered/unordered_flat_map.hpp>
 
 namespace matching{
@@ -33,20 +35,106 @@ struct Order{
     TimeInForce tif;
 };
 
-struct Trade{
-    SymbolId symbol_id;
-    const char* symbol_name; //borrowed pointer, valid for engine lifetime
+//one execution, fixed layout with no pointers or padding: it can be memcpy'd
+//into rings, shared memory and files and read back by another process. Names
+//are resolved at the edge (MatchingEngine::symbolName(symbol_id)). Users, seq,
+//event_seq and ts_ns are filled in by MatchingEngine (0 from a bare OrderBook)
+struct TradeRecord{
     Price price;
     Qty qty;
     OrderId buy_id;
     OrderId sell_id;
+    UserId buy_user;         //resting side: only with MATCHING_ENABLE_USER_TRACKING, else 0
+    UserId sell_user;
+    std::uint64_t seq;       //engine-wide trade number, 1, 2, ... across all symbols
+    std::uint64_t event_seq; //engine sequence number of the input event that traded
+    std::int64_t ts_ns;      //that event's TscClock timestamp
+    SymbolId symbol_id;
+    Side aggressor;
+    std::uint8_t pad[3];
 };
 
+static_assert(std::is_trivially_copyable_v<TradeRecord> && std::is_standard_layout_v<TradeRecord>,
+              "TradeRecord must be memcpy-able");
+static_assert(sizeof(TradeRecord) == 80, "TradeRecord layout");
+
+using Trade = TradeRecord;
+
 struct BookStats{
     std::uint64_t trade_count{0};
     Qty traded_qty{0};
     Price last_trade_price{0};
     bool has_last_trade{false};
+    Price high{0};                     //session high/low, valid if has_last_trade
+    Price low{0};
+    std::int64_t traded_notional{0};   //sum of price * qty
+
+    double vwap() const{
+        return traded_qty > 0 ? static_cast<double>(traded_notional) / traded_qty : 0.0;
+    }
+};
+
+//one OHLCV bar; start_ns is the interval start (the bar time given to the book,
+//aligned to interval_ns)
+struct Bar{
+    std::int64_t start_ns;
+    Price open;
+    Price high;
+    Price low;
+    Price close;
+    Qty volume;
+    std::uint64_t trade_count;
+};
+
+struct BarConfig{
+    std::int64_t interval_ns{1'000'000'000};
+    std::size_t capacity{0}; //bars kept per book (ring); 0 disables bars
+};
+
+//columnar bar export: one array per field, oldest bar first
+struct BarColumns{
+    std::vector<std::int64_t> start_ns;
+    std::vector<Price> open;
+    std::vector<Price> high;
+    std::vector<Price> low;
+    std::vector<Price> close;
+    std::vector<Qty> volume;
+    std::vector<std::uint64_t> trade_count;
+
+    std::size_t size() const{return start_ns.size();}
+
+    void clear(){
+        start_ns.clear(); open.clear(); high.clear(); low.clear();
+        close.clear(); volume.clear(); trade_count.clear();
+    }
+
+    void push_back(const Bar& b){
+        start_ns.push_back(b.start_ns);
+        open.push_back(b.open);
+        high.push_back(b.high);
+        low.push_back(b.low);
+        close.push_back(b.close);
+        volume.push_back(b.volume);
+        trade_count.push_back(b.trade_count);
+    }
+};
+
+struct SignalConfig{
+    std::size_t depth_levels{5}; //levels per side summed for depth imbalance
+    double trade_decay{0.1};     //weight of the newest trade in the flow/price EWMAs
+};
+
+//microstructure signals; every field is kept up to date by the book on each
+//change, so reading them is O(1) and allocation-free
+struct BookSignals{
+    Qty bid_depth{0};               //resting qty in the top depth_levels bid levels
+    Qty ask_depth{0};
+    double depth_imbalance{0};      //(bid - ask) / (bid + ask), in [-1, 1]
+    double microprice{0};           //best prices weighted by the opposite best size
+    bool has_microprice{false};
+    double trade_flow_imbalance{0}; //decayed (buy - sell aggressor qty) / qty, in [-1, 1]
+    double trade_price_ewma{0};
+    bool has_trade{false};
 };
 
 template<typename TradeCallback>
@@ -56,6 +144,10 @@ public:
         symbol_id_(symbol_id), symbol_name_(symbol_name),
         callback_(std::move(cb)), next_id_(1) {}
 
+    //non-copyable, non-movable (price levels hold a pointer to pool_)
+    OrderBook(const OrderBook&) = delete;
+    OrderBook& operator=(const OrderBook&) = delete;
+
     OrderId addLimit(Side side, Price price, Qty qty, TimeInForce tif = TimeInForce::GFD){
         Order o{next_id_++, price, qty, side, OrderType::Limit, tif};
         if(o.tif == TimeInForce::FOK){
@@ -81,23 +173,77 @@ public:
         if(loc.side == Side::Buy){
             auto lvlIt = bids_.find(loc.price);
             if(lvlIt == bids_.end()){index_.erase(it); return false;}
+            if(loc.price == bids_.rbegin()->first){++bbo_seq_;}
             PriceLevel& lvl = lvlIt->second;
-            if(loc.it->qty > 0){lvl.total_qty -= loc.it->qty;}
+            if(loc.it->qty > 0){
+                lvl.total_qty -= loc.it->qty;
+                depthChanged(bids_, lvlIt, bid_depth_, -loc.it->qty);
+            }
+            state_hash_ -= orderHash(*loc.it);
             lvl.orders.erase(loc.it);
             index_.erase(it);
-            if(lvl.orders.empty()){bids_.erase(lvlIt);}
+            if(lvl.orders.empty()){eraseLevel(bids_, lvlIt, bid_depth_);}
         } else {
             auto lvlIt = asks_.find(loc.price);
             if(lvlIt == asks_.end()){index_.erase(it); return false;}
+            if(loc.price == asks_.rbegin()->first){++bbo_seq_;}
             PriceLevel& lvl = lvlIt->second;
-            if(loc.it->qty > 0){lvl.total_qty -= loc.it->qty;}
+            if(loc.it->qty > 0){
+                lvl.total_qty -= loc.it->qty;
+                depthChanged(asks_, lvlIt, ask_depth_, -loc.it->qty);
+            }
+            state_hash_ -= orderHash(*loc.it);
             lvl.orders.erase(loc.it);
             index_.erase(it);
-            if(lvl.orders.empty()){asks_.erase(lvlIt);}
+            if(lvl.orders.empty()){eraseLevel(asks_, lvlIt, ask_depth_);}
         }
         return true;
     }
 
+    //amend a resting order. Same price with qty <= remaining reduces in place and
+    //keeps queue priority (returns the same id); a price change or size increase
+    //loses priority (cancel + new, returns the new id). Returns 0 if the order is
+    //unknown or qty <= 0 (order cancelled)
+    OrderId amend(OrderId id, Price price, Qty qty){
+        auto it = index_.find(id);
+        if(it == index_.end()){return 0;}
+        const OrderLocator loc = it->second;
+        if(qty <= 0){cancel(id); return 0;}
+
+        if(price == loc.price && qty <= loc.it->qty){
+            if(qty == loc.it->qty){return id;}
+            const bool at_best = loc.side == Side::Buy
+                ? loc.price == bids_.rbegin()->first
+                : loc.price == asks_.rbegin()->first;
+            Qty delta = loc.it->qty - qty;
+            state_hash_ -= orderHash(*loc.it);
+            loc.it->qty = qty;
+            state_hash_ += orderHash(*loc.it);
+            if(loc.side == Side::Buy){
+                auto lvlIt = bids_.find(loc.price);
+                lvlIt->second.total_qty -= delta;
+                depthChanged(bids_, lvlIt, bid_depth_, -delta);
+            }
+            else{
+                auto lvlIt = asks_.find(loc.price);
+                lvlIt->second.total_qty -= delta;
+                depthChanged(asks_, lvlIt, ask_depth_, -delta);
+            }
+            if(at_best){++bbo_seq_;}
+            return id;
+        }
+
+        const Side side = loc.side;
+        cancel(id);
+        return addLimit(side, price, qty, TimeInForce::GFD);
+    }
+
+    const Order* findOrder(OrderId id) const{
+        auto it = index_.find(id);
+        if(it == index_.end()){return nullptr;}
+        return &*it->second.it;
+    }
+
     std::optional<Price> bestBid() const{
         if(bids_.empty()){return std::nullopt;}
         return bids_.rbegin()->first;
@@ -126,6 +272,24 @@ public:
         return (*bb + *ba) / 2;
     }
 
+    //total resting qty at one price (0 if no level)
+    Qty levelQty(Side side, Price price) const{
+        if(side == Side::Buy){
+            auto it = bids_.find(price);
+            return it == bids_.end() ? 0 : it->second.total_qty;
+        }
+        auto it = asks_.find(price);
+        return it == asks_.end() ? 0 : it->second.total_qty;
+    }
+
+    //id the next new order will receive
+    OrderId nextOrderId() const {return next_id_;}
+
+    //rebuilding from a snapshot: orders in forEachOrder order, each appended at
+    //the back of its level without matching, then the id counter
+    void restoreOrder(const Order& o){addRestingOrder(o);}
+    void restoreNextOrderId(OrderId id){next_id_ = id;}
+
     SymbolId symbolId() const {return symbol_id_;}
     const char* symbolName() const {return symbol_name_;}
 
@@ -151,18 +315,92 @@ public:
         if(shown == 0){os << "\t\t<empty>\n";}
     }
 
+    //resting orders, each side best level first and in time priority within a
+    //level, bids then asks; f(const Order&)
+    template<typename F>
+    void forEachOrder(F&& f) const{
+        for(auto it = bids_.rbegin(); it != bids_.rend(); ++it){
+            for(const Order& o: it->second.orders){f(o);}
+        }
+        for(auto it = asks_.rbegin(); it != asks_.rend(); ++it){
+            for(const Order& o: it->second.orders){f(o);}
+        }
+    }
+
     const BookStats& stats() const{return stats_;}
 
+    BookSignals signals() const{
+        BookSignals s;
+        s.bid_depth = bid_depth_;
+        s.ask_depth = ask_depth_;
+        if(bid_depth_ + ask_depth_ > 0){
+            s.depth_imbalance = static_cast<double>(bid_depth_ - ask_depth_) / (bid_depth_ + ask_depth_);
+        }
+        if(!bids_.empty() && !asks_.empty()){
+            const auto& bb = *bids_.rbegin();
+            const auto& ba = *asks_.rbegin();
+            const double bq = static_cast<double>(bb.second.total_qty);
+            const double aq = static_cast<double>(ba.second.total_qty);
+            s.microprice = (bb.first * aq + ba.first * bq) / (bq + aq);
+            s.has_microprice = true;
+        }
+        if(flow_qty_ > 0){s.trade_flow_imbalance = flow_signed_ / flow_qty_;}
+        s.trade_price_ewma = trade_price_ewma_;
+        s.has_trade = stats_.has_last_trade;
+        return s;
+    }
+
+    const SignalConfig& signalConfig() const{return signal_config_;}
+
+    //resets the ring; the buffer is allocated here, never on the trade path
+    void setBarConfig(const BarConfig& config){
+        bar_config_ = config;
+        if(bar_config_.interval_ns <= 0){bar_config_.interval_ns = 1;}
+        bars_.assign(bar_config_.capacity, Bar{});
+        bar_head_ = 0;
+        bar_count_ = 0;
+    }
+
+    //time the following trades are bucketed under; MatchingEngine passes each
+    //event's timestamp (recorded or TscClock), so a bare book must set it itself
+    void setBarTime(std::int64_t ns){bar_ns_ = ns;}
+
+    const BarConfig& barConfig() const{return bar_config_;}
+    std::size_t barCount() const{return bar_count_;}
+
+    //i-th retained bar, oldest first (i < barCount())
+    const Bar& bar(std::size_t i) const{
+        return bars_[(bar_head_ + bars_.size() - bar_count_ + i) % bars_.size()];
+    }
+
+    //appends the retained bars, oldest first (reuse `out` to avoid reallocating)
+    void exportBars(BarColumns& out) const{
+        for(std::size_t i = 0; i < bar_count_; ++i){out.push_back(bar(i));}
+    }
+
+    //depth sums are rebuilt once for the new window; trade EWMAs carry over
+    void setSignalConfig(const SignalConfig& config){
+        signal_config_ = config;
+        bid_depth_ = sumTopLevels(bids_);
+        ask_depth_ = sumTopLevels(asks_);
+    }
+
+    //bumped whenever best bid/ask price or size changes; compare before/after an op
+    std::uint64_t bboSeq() const{return bbo_seq_;}
+
+    //digest of the resting orders, kept up to date on every add, fill, amend and
+    //cancel: the sum of one hash per (side, price, id, qty). Ids order each level,
+    //so equal books have equal digests, and reading it is O(1)
+    std::uint64_t stateHash() const{return state_hash_;}
+
     void reserveIndex(std::size_t n){index_.reserve(n);}
 
 private:
-    //pool allocator with null_mutex: no mutex overhead for single-threaded use
-    using OrderList = std::list<Order,
-        boost::fast_pool_allocator<Order,
-            boost::default_user_allocator_new_delete,
-            boost::details::pool::null_mutex>>;
+    //per-book node pool: no locking, and independent engines can run on separate threads
+    using OrderList = std::list<Order, PoolAllocator<Order>>;
 
     struct PriceLevel{
+        explicit PriceLevel(NodePool* pool): orders(PoolAllocator<Order>(pool)){}
         Qty total_qty{0};
         OrderList orders;
     };
@@ -185,17 +423,112 @@ private:
     TradeCallback callback_;
     OrderId next_id_;
 
+    NodePool pool_; //declared before the sides: outlives every OrderList
     BidSide bids_;
     AskSide asks_;
     OrderIndex index_;
     BookStats stats_;
+    std::uint64_t bbo_seq_{0};
+    std::uint64_t state_hash_{0};
+
+    SignalConfig signal_config_;
+    Qty bid_depth_{0};
+    Qty ask_depth_{0};
+    double flow_signed_{0};
+    double flow_qty_{0};
+    double trade_price_ewma_{0};
+
+    BarConfig bar_config_;
+    std::vector<Bar> bars_; //ring of bar_config_.capacity bars
+    std::size_t bar_head_{0}; //next slot to open
+    std::size_t bar_count_{0};
+    std::int64_t bar_ns_{0};
+
+    static std::uint64_t orderHash(const Order& o){
+        std::uint64_t z = static_cast<std::uint64_t>(o.id) * 0x9e3779b97f4a7c15ull +
+                          static_cast<std::uint64_t>(o.price) * 0xc2b2ae3d27d4eb4full +
+                          static_cast<std::uint64_t>(o.qty) * 0x165667b19e3779f9ull +
+                          static_cast<std::uint64_t>(o.side);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    void updateBar(Price price, Qty qty){
+        const std::int64_t start = bar_ns_ - bar_ns_ % bar_config_.interval_ns;
+        const std::size_t cap = bars_.size();
+        if(bar_count_ == 0 || bars_[(bar_head_ + cap - 1) % cap].start_ns != start){
+            bars_[bar_head_] = Bar{start, price, price, price, price, 0, 0};
+            bar_head_ = (bar_head_ + 1) % cap;
+            if(bar_count_ < cap){++bar_count_;}
+        }
+        Bar& b = bars_[(bar_head_ + cap - 1) % cap];
+        b.high = std::max(b.high, price);
+        b.low = std::min(b.low, price);
+        b.close = price;
+        b.volume += qty;
+        ++b.trade_count;
+    }
+
+    //a level is in the depth window if it is among the depth_levels best.
+    //Both sides keep best at the back, so that is a suffix of the flat_map
+    template<typename Levels>
+    bool inDepthWindow(const Levels& levels, typename Levels::const_iterator it) const{
+        return levels.index_of(it) + signal_config_.depth_levels >= levels.size();
+    }
+
+    template<typename Levels>
+    void depthChanged(const Levels& levels, typename Levels::const_iterator it, Qty& depth, Qty delta){
+        if(inDepthWindow(levels, it)){depth += delta;}
+    }
 
-    void emitTrade(Price price, Qty qty, OrderId buy_id, OrderId sell_id){
+    //a new level inside the window pushes the previous last one out
+    template<typename Levels>
+    void levelInserted(const Levels& levels, typename Levels::const_iterator it, Qty& depth){
+        const std::size_t n = signal_config_.depth_levels;
+        if(levels.size() > n && inDepthWindow(levels, it)){
+            depth -= levels.nth(levels.size() - n - 1)->second.total_qty;
+        }
+    }
+
+    //removing a level inside the window pulls the next one in
+    template<typename Levels>
+    void eraseLevel(Levels& levels, typename Levels::iterator it, Qty& depth){
+        const std::size_t n = signal_config_.depth_levels;
+        if(levels.size() > n && inDepthWindow(levels, it)){
+            depth += levels.nth(levels.size() - n - 1)->second.total_qty;
+        }
+        levels.erase(it);
+    }
+
+    template<typename Levels>
+    Qty sumTopLevels(const Levels& levels) const{
+        Qty sum = 0;
+        std::size_t shown = 0;
+        for(auto it = levels.rbegin(); it != levels.rend() && shown < signal_config_.depth_levels; ++it, ++shown){
+            sum += it->second.total_qty;
+        }
+        return sum;
+    }
+
+    void emitTrade(Price price, Qty qty, OrderId buy_id, OrderId sell_id, Side aggressor){
         ++stats_.trade_count;
         stats_.traded_qty += qty;
+        const double a = signal_config_.trade_decay;
+        const double signed_qty = aggressor == Side::Buy ? qty : -qty;
+        flow_signed_ += a * (signed_qty - flow_signed_);
+        flow_qty_ += a * (static_cast<double>(qty) - flow_qty_);
+        trade_price_ewma_ = stats_.has_last_trade
+            ? trade_price_ewma_ + a * (static_cast<double>(price) - trade_price_ewma_)
+            : static_cast<double>(price);
+        stats_.high = stats_.has_last_trade ? std::max(stats_.high, price) : price;
+        stats_.low = stats_.has_last_trade ? std::min(stats_.low, price) : price;
+        stats_.traded_notional += price * qty;
         stats_.last_trade_price = price;
         stats_.has_last_trade = true;
-        callback_(Trade{symbol_id_, symbol_name_, price, qty, buy_id, sell_id});
+        if(!bars_.empty()){updateBar(price, qty);}
+        ++bbo_seq_; //every fill consumes the best level
+        callback_(TradeRecord{price, qty, buy_id, sell_id, 0, 0, 0, 0, 0, symbol_id_, aggressor, {}});
     }
 
     void match(Order& incoming){
@@ -216,11 +549,14 @@ private:
             while(it != lvl.orders.end() && buy.qty > 0){
                 Order& sell = *it;
                 Qty traded = std::min(buy.qty, sell.qty);
+                state_hash_ -= orderHash(sell);
                 buy.qty -= traded;
                 sell.qty -= traded;
+                if(sell.qty > 0){state_hash_ += orderHash(sell);}
                 lvl.total_qty -= traded;
+                depthChanged(asks_, bestAskIt, ask_depth_, -traded);
 
-                emitTrade(bestAskPx, traded, buy.id, sell.id);
+                emitTrade(bestAskPx, traded, buy.id, sell.id, Side::Buy);
 
                 if(sell.qty == 0){
                     index_.erase(sell.id);
@@ -228,7 +564,7 @@ private:
                 }
                 else{++it;}
             }
-            if(lvl.orders.empty()){asks_.erase(bestAskIt);} //O(1) erase at end
+            if(lvl.orders.empty()){eraseLevel(asks_, bestAskIt, ask_depth_);} //O(1) erase at end
         }
     }
 
@@ -245,11 +581,14 @@ private:
             while(it != lvl.orders.end() && sell.qty > 0){
                 Order& buy = *it;
                 Qty traded = std::min(sell.qty, buy.qty);
+                state_hash_ -= orderHash(buy);
                 sell.qty -= traded;
                 buy.qty -= traded;
+                if(buy.qty > 0){state_hash_ += orderHash(buy);}
                 lvl.total_qty -= traded;
+                depthChanged(bids_, bestBidIt, bid_depth_, -traded);
 
-                emitTrade(bestBidPx, traded, buy.id, sell.id);
+                emitTrade(bestBidPx, traded, buy.id, sell.id, Side::Sell);
 
                 if(buy.qty == 0){
                     index_.erase(buy.id);
@@ -257,21 +596,31 @@ private:
                 }
                 else{++it;}
             }
-            if(lvl.orders.empty()){bids_.erase(bestBidIt);} //O(1) erase at end
+            if(lvl.orders.empty()){eraseLevel(bids_, bestBidIt, bid_depth_);} //O(1) erase at end
         }
     }
 
     void addRestingOrder(const Order& o){
         if(o.side == Side::Buy){
-            PriceLevel& lvl = bids_[o.price];
+            auto [lvlIt, inserted] = bids_.try_emplace(o.price, &pool_);
+            if(inserted){levelInserted(bids_, lvlIt, bid_depth_);}
+            PriceLevel& lvl = lvlIt->second;
             lvl.orders.push_back(o);
             lvl.total_qty += o.qty;
+            state_hash_ += orderHash(o);
+            depthChanged(bids_, lvlIt, bid_depth_, o.qty);
             index_[o.id] = OrderLocator{o.side, o.price, std::prev(lvl.orders.end())};
+            if(o.price == bids_.rbegin()->first){++bbo_seq_;}
         } else {
-            PriceLevel& lvl = asks_[o.price];
+            auto [lvlIt, inserted] = asks_.try_emplace(o.price, &pool_);
+            if(inserted){levelInserted(asks_, lvlIt, ask_depth_);}
+            PriceLevel& lvl = lvlIt->second;
             lvl.orders.push_back(o);
             lvl.total_qty += o.qty;
+            state_hash_ += orderHash(o);
+            depthChanged(asks_, lvlIt, ask_depth_, o.qty);
             index_[o.id] = OrderLocator{o.side, o.price, std::prev(lvl.orders.end())};
+            if(o.price == asks_.rbegin()->first){++bbo_seq_;}
         }
     }
 
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "journal.hpp"
+#include "latency_stats.hpp"
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+namespace matching{
+
+//releases recorded events at their original spacing, scaled by speed (2 = twice
+//as fast, 0 = no pacing). Long gaps sleep until spin_ns before the due time and
+//spin the rest, so the release jitter is the spin loop's, not the scheduler's
+class ReplayPacer{
+public:
+    explicit ReplayPacer(double speed, std::int64_t spin_ns = 100'000):
+        speed_(speed), spin_ns_(spin_ns) {}
+
+    //anchors the first recorded timestamp to now
+    void start(std::int64_t first_ts){
+        first_ts_ = first_ts;
+        start_ns_ = latencyNowNs();
+    }
+
+    //blocks until the event recorded at ts is due; returns how late it is
+    //released (ns, >= 0)
+    std::int64_t wait(std::int64_t ts){
+        if(speed_ <= 0){return 0;}
+        const std::int64_t due = start_ns_ + static_cast<std::int64_t>(static_cast<double>(ts - first_ts_) / speed_);
+        std::int64_t now = latencyNowNs();
+        if(due - now > spin_ns_){
+            std::this_thread::sleep_for(std::chrono::nanoseconds(due - now - spin_ns_));
+            ++sleeps_;
+            now = latencyNowNs();
+        }
+        while(now < due){now = latencyNowNs();}
+        return now - due;
+    }
+
+    bool paced() const{return speed_ > 0;}
+    std::uint64_t sleeps() const{return sleeps_;}
+
+private:
+    double speed_;
+    std::int64_t spin_ns_;
+    std::int64_t first_ts_{0};
+    std::int64_t start_ns_{0};
+    std::uint64_t sleeps_{0};
+};
+
+struct PacingStats{
+    LatencyHistogram lateness; //release time minus due time
+    std::uint64_t events{0};
+    std::uint64_t sleeps{0};
+    std::int64_t recorded_ns{0}; //first to last timestamp on the tape
+    std::int64_t elapsed_ns{0};  //wall time the replay took
+};
+
+//hands each tape event to submit(const InternalEvent&) at its recorded pace;
+//a tape without timestamps is replayed unpaced
+template<typename Submit>
+PacingStats replayPaced(const EventTape& tape, double speed, Submit&& submit){
+    PacingStats stats;
+    const bool timed = tape.timestamps.size() == tape.events.size() && !tape.events.empty();
+    ReplayPacer pacer(timed ? speed : 0.0);
+    if(timed){
+        pacer.start(tape.timestamps.front());
+        stats.recorded_ns = tape.timestamps.back() - tape.timestamps.front();
+    }
+    const std::int64_t begin = latencyNowNs();
+    for(std::size_t i = 0; i < tape.events.size(); ++i){
+        if(pacer.paced()){stats.lateness.record(pacer.wait(tape.timestamps[i]));}
+        submit(tape.events[i]);
+    }
+    stats.elapsed_ns = latencyNowNs() - begin;
+    stats.events = tape.events.size();
+    stats.sleeps = pacer.sleeps();
+    return stats;
+}
+
+}
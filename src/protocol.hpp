@@ -248,4 +248,18 @@ inline bool parseLine(const std::string& rawLine, Event& out){
         return false;
     }
 }
-}
\ No newline at end of file
+
+//event logs follow each L/M/R line with "#ack,<id>": the id the engine assigned
+//(0 when rejected). A comment to parseLine, so older readers skip it
+inline bool parseAckLine(const std::string& line, OrderId& out){
+    if(line.rfind("#ack,", 0) != 0){return false;}
+    try{
+        out = static_cast<OrderId>(std::stoull(line.substr(5)));
+    } catch(...){
+        return false;
+    }
+    return true;
+}
+
+inline std::string formatAckLine(OrderId id){return "#ack," + std::to_string(id);}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "matching_engine.hpp"
+#include <boost/lockfree/spsc_queue.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace matching{
+
+//a second MatchingEngine on its own thread that applies the primary's stream
+//of applied events in the same order, so every read-only question (depth,
+//positions, stats, snapshots, printBook) can be answered there instead of on
+//the matching thread. The primary's cost is one ring push per event.
+//
+//The primary thread is the only caller of feed(); any number of threads may
+//query(). Queries run under a lock the replica thread takes once per batch, so
+//they see the state between two batches. An idle replica spins briefly, then
+//sleeps kIdleSleepUs between polls, so a quiet primary costs no core
+class ReadReplica{
+public:
+    explicit ReadReplica(std::size_t capacity = 1 << 20): ring_(capacity), running_(true){
+        worker_ = std::thread(&ReadReplica::runLoop, this);
+    }
+
+    ~ReadReplica(){stop();}
+
+    ReadReplica(const ReadReplica&) = delete;
+    ReadReplica& operator=(const ReadReplica&) = delete;
+
+    //primary thread, after applying e; symbols: the primary's index, for the
+    //names of SymbolIds the replica has not seen yet (its ids follow the primary's)
+    void feed(const InternalEvent& e, const SymbolIndex& symbols){
+        while(defined_ <= e.symbol){
+            InternalEvent def{};
+            def.symbol = defined_;
+            push(Entry{def, symbols.nameCStr(defined_)});
+            ++defined_;
+        }
+        push(Entry{e, nullptr});
+        fed_.store(fed_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    //events handed over / applied so far
+    std::uint64_t fed() const{return fed_.load(std::memory_order_acquire);}
+    std::uint64_t applied() const{return applied_.load(std::memory_order_acquire);}
+
+    //f(const MatchingEngine&) once the replica has applied at least min_applied
+    //events (e.g. fed() from the primary thread: read-your-writes)
+    template<typename F>
+    decltype(auto) query(F&& f, std::uint64_t min_applied = 0) const{
+        while(applied() < min_applied){std::this_thread::yield();}
+        std::lock_guard<std::mutex> lock(mutex_);
+        return f(static_cast<const MatchingEngine&>(engine_));
+    }
+
+    //applies what was fed, then joins the replica thread
+    void stop(){
+        bool expected = true;
+        if(running_.compare_exchange_strong(expected, false) && worker_.joinable()){worker_.join();}
+    }
+
+private:
+    struct Entry{
+        InternalEvent event;
+        const char* name; //set: defines SymbolId event.symbol (stable primary storage)
+    };
+
+    static constexpr int kBatch = 256;
+    static constexpr int kIdleSpins = 1000;   //empty polls before sleeping
+    static constexpr int kIdleSleepUs = 100;
+
+    MatchingEngine engine_;
+    boost::lockfree::spsc_queue<Entry> ring_;
+    mutable std::mutex mutex_;
+    std::atomic<bool> running_;
+    std::atomic<std::uint64_t> fed_{0};
+    std::atomic<std::uint64_t> applied_{0};
+    SymbolId defined_{0}; //primary thread only
+    std::thread worker_;
+
+    void push(const Entry& entry){
+        while(!ring_.push(entry)){std::this_thread::yield();}
+    }
+
+    void runLoop(){
+        Entry entry{};
+        int idle = 0;
+        while(true){
+            std::uint64_t n = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for(int i = 0; i < kBatch && ring_.pop(entry); ++i){
+                    if(entry.name){
+                        engine_.resolveSymbol(entry.name);
+                        continue;
+                    }
+                    engine_.processInternal(entry.event);
+                    ++n;
+                }
+            }
+            if(n != 0){
+                applied_.store(applied_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+                idle = 0;
+                continue;
+            }
+            if(ring_.read_available() != 0){continue;}
+            if(!running_.load(std::memory_order_acquire)){
+                if(ring_.read_available() == 0){return;}
+                continue;
+            }
+            if(++idle < kIdleSpins){std::this_thread::yield();}
+            else{std::this_thread::sleep_for(std::chrono::microseconds(kIdleSleepUs));}
+        }
+    }
+};
+
+}
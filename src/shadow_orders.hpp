@@ -0,0 +1,208 @@
+#pragma once
+
+#include "matching_engine.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace matching{
+
+//queue-position fill model for backtests: simulated orders never enter the
+//historical book (so replayed history is unaltered); instead each one tracks
+//the qty queued ahead of it at its price level.
+//
+//Order ids are allocated monotonically per book, so "was resting when we
+//joined" is simply id < watermark (the book's next id at join time). Historical
+//cancels of such orders and trades against them shrink qty_ahead; once a trade
+//hits an order behind us, or trades through our price, we are filled instead.
+//
+//That fill comes out of the historical aggressor's qty: a shadow order gets at
+//most what the aggressor had left after the trades that came before it in
+//this event, once per event, and the aggressor's own later trades still take
+//their share of what remains. Shadow orders on the same side share that qty
+//in the order they are checked, not strictly by price
+class ShadowOrders{
+public:
+    struct Fill{
+        std::uint32_t maker;
+        Side side;
+        OrderId id;
+        Price price;
+        Qty qty;
+    };
+
+    //per-maker order gateway (same surface as MatchingEngine for SimpleMarketMaker)
+    class Gateway{
+    public:
+        Gateway(ShadowOrders& orders, std::uint32_t maker): orders_(&orders), maker_(maker){}
+
+        TopOfBook topOfBook(SymbolId symbol) const{return orders_->engine_.topOfBook(symbol);}
+
+        OrderId newLimit(SymbolId symbol, UserId, Side side, Price price, Qty qty,
+                         TimeInForce = TimeInForce::GFD){
+            return orders_->place(maker_, symbol, side, price, qty);
+        }
+
+        bool cancel(SymbolId symbol, OrderId id){return orders_->cancel(symbol, id);}
+
+        OrderId amend(SymbolId symbol, OrderId id, Price price, Qty qty){
+            return orders_->amend(maker_, symbol, id, price, qty);
+        }
+
+    private:
+        ShadowOrders* orders_;
+        std::uint32_t maker_;
+    };
+
+    explicit ShadowOrders(const MatchingEngine& engine): engine_(engine){}
+
+    //call before the engine processes a historical event
+    void beginEvent(const InternalEvent& e){
+        ++event_;
+        aggressor_ = e.side;
+        aggressor_left_ = e.type == EventType::Cancel ? 0 : e.qty;
+        if(e.type != EventType::Cancel && e.type != EventType::Replace && e.type != EventType::Amend){return;}
+        const bool watched = e.symbol < by_symbol_.size() && !by_symbol_[e.symbol].empty();
+        if(!watched){return;} //no shadow order can be hit or moved up
+        const auto* book = engine_.findBook(e.symbol);
+        const Order* o = book ? book->findOrder(e.id) : nullptr;
+        //an amend trades as the order it modifies, with at most its new qty (a
+        //replace is a new order on e.side, as MatchingEngine::replace places it)
+        if(e.type == EventType::Amend){
+            aggressor_ = o ? o->side : e.side;
+            aggressor_left_ = o ? std::max<Qty>(0, e.qty) : 0;
+        }
+        if(!o){return;}
+        //an amend down in size at the same price keeps its place: only the cut leaves the queue
+        const bool keeps_place = e.type == EventType::Amend && e.price == o->price && e.qty > 0 && e.qty <= o->qty;
+        const Qty leaving = keeps_place ? o->qty - e.qty : o->qty;
+        for(ShadowOrder& s: by_symbol_[e.symbol]){
+            if(s.side == o->side && s.price == o->price && o->id < s.watermark){
+                s.qty_ahead = std::max<Qty>(0, s.qty_ahead - leaving);
+            }
+        }
+    }
+
+    //hook for the engine's trade callback while a historical event is processed
+    void onTrade(const Trade& t){
+        if(t.symbol_id >= by_symbol_.size()){return;}
+        auto& shadows = by_symbol_[t.symbol_id];
+        if(shadows.empty()){return;}
+
+        for(ShadowOrder& s: shadows){
+            if(s.side == aggressor_){continue;} //same side as the aggressor: not hit
+            if(s.filled_event == event_){continue;} //already took its share of this aggressor
+            const OrderId resting = s.side == Side::Buy ? t.buy_id : t.sell_id;
+            const bool through = s.side == Side::Buy ? t.price < s.price : t.price > s.price;
+            if(t.price == s.price && resting < s.watermark){
+                s.qty_ahead = std::max<Qty>(0, s.qty_ahead - t.qty);
+            }
+            else if(through || t.price == s.price){
+                //we would have traded before this trade: whatever the aggressor had left
+                const Qty qty = std::min(s.remaining, aggressor_left_);
+                fill(s, s.price, qty);
+                aggressor_left_ -= std::max<Qty>(0, qty);
+                s.filled_event = event_;
+            }
+        }
+        aggressor_left_ = std::max<Qty>(0, aggressor_left_ - t.qty);
+        eraseFilled(shadows);
+    }
+
+    //fills produced since the last call
+    std::vector<Fill>& fills(){return fills_;}
+
+    Qty queueAhead(SymbolId symbol, OrderId id) const{
+        if(const ShadowOrder* s = find(symbol, id)){return s->qty_ahead;}
+        return 0;
+    }
+
+private:
+    struct ShadowOrder{
+        OrderId id;
+        std::uint32_t maker;
+        Side side;
+        Price price;
+        Qty remaining;
+        Qty qty_ahead;
+        OrderId watermark;
+        std::uint64_t filled_event; //last event this order was filled in
+    };
+
+    const MatchingEngine& engine_;
+    std::vector<std::vector<ShadowOrder>> by_symbol_; //few live orders per symbol
+    std::vector<Fill> fills_;
+    OrderId next_id_{1};
+    Side aggressor_{Side::Buy};
+    Qty aggressor_left_{0}; //aggressor qty not yet traded, historically or by us, this event
+    std::uint64_t event_{0};
+
+    OrderId place(std::uint32_t maker, SymbolId symbol, Side side, Price price, Qty qty){
+        if(symbol >= by_symbol_.size()){by_symbol_.resize(symbol + 1);}
+        const OrderId id = next_id_++;
+        const auto* book = engine_.findBook(symbol);
+        ShadowOrder s{id, maker, side, price, qty, 0, OrderId{1}, 0};
+
+        //marketable on arrival: take the visible opposite best level (book untouched)
+        if(book){
+            auto opp_px = side == Side::Buy ? book->bestAsk() : book->bestBid();
+            auto opp_qty = side == Side::Buy ? book->bestAskSize() : book->bestBidSize();
+            if(opp_px && (side == Side::Buy ? price >= *opp_px : price <= *opp_px)){
+                fill(s, *opp_px, std::min(s.remaining, *opp_qty));
+                if(s.remaining == 0){return id;}
+            }
+            s.qty_ahead = book->levelQty(side, price);
+            s.watermark = book->nextOrderId();
+        }
+        by_symbol_[symbol].push_back(s);
+        return id;
+    }
+
+    bool cancel(SymbolId symbol, OrderId id){
+        if(symbol >= by_symbol_.size()){return false;}
+        auto& shadows = by_symbol_[symbol];
+        auto it = std::find_if(shadows.begin(), shadows.end(),
+                               [id](const ShadowOrder& s){return s.id == id;});
+        if(it == shadows.end()){return false;}
+        shadows.erase(it);
+        return true;
+    }
+
+    //same-price size-down keeps queue position, anything else re-joins at the back
+    OrderId amend(std::uint32_t maker, SymbolId symbol, OrderId id, Price price, Qty qty){
+        ShadowOrder* s = find(symbol, id);
+        if(!s){return 0;}
+        if(qty <= 0){cancel(symbol, id); return 0;}
+        if(price == s->price && qty <= s->remaining){
+            s->remaining = qty;
+            return id;
+        }
+        const Side side = s->side;
+        cancel(symbol, id);
+        return place(maker, symbol, side, price, qty);
+    }
+
+    ShadowOrder* find(SymbolId symbol, OrderId id){
+        if(symbol >= by_symbol_.size()){return nullptr;}
+        for(ShadowOrder& s: by_symbol_[symbol]){if(s.id == id){return &s;}}
+        return nullptr;
+    }
+
+    const ShadowOrder* find(SymbolId symbol, OrderId id) const{
+        return const_cast<ShadowOrders*>(this)->find(symbol, id);
+    }
+
+    void fill(ShadowOrder& s, Price price, Qty qty){
+        if(qty <= 0){return;}
+        s.remaining -= qty;
+        fills_.push_back(Fill{s.maker, s.side, s.id, price, qty});
+    }
+
+    static void eraseFilled(std::vector<ShadowOrder>& shadows){
+        shadows.erase(std::remove_if(shadows.begin(), shadows.end(),
+                                     [](const ShadowOrder& s){return s.remaining <= 0;}),
+                      shadows.end());
+    }
+};
+
+}
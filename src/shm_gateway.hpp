@@ -0,0 +1,404 @@
+#pragma once
+
+#include "async_matching_engine.hpp"
+#include "latency_stats.hpp"
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace matching{
+
+//--- shared-memory order entry: one named segment, per-client SPSC rings ---
+//
+//Segment layout (all offsets fixed at creation):
+//  ShmControl: magic, geometry, engine heartbeat, symbol directory, slot table
+//  per slot:   request ring (SessionRequest), report ring (ExecReport)
+//Records are the engine's own SessionRequest / ExecReport, copied by value, so a
+//client process submits without a syscall and the engine thread pops them like
+//an in-process StrategySession. Both ends must be built from the same headers.
+
+static_assert(std::is_trivially_copyable_v<SessionRequest>, "SessionRequest must be memcpy-able");
+static_assert(std::is_trivially_copyable_v<ExecReport>, "ExecReport must be memcpy-able");
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "shm rings need address-free atomics");
+
+struct ShmRingHeader{
+    alignas(64) std::atomic<std::uint64_t> head; //next write (producer)
+    alignas(64) std::atomic<std::uint64_t> tail; //next read (consumer)
+};
+
+//one side's view of a ring living in the segment. Each process holds its own
+//view; the opposite index is cached so the shared line is read only when the
+//ring looks full (producer) or empty (consumer)
+template<typename T>
+class ShmRing{
+public:
+    ShmRing() = default;
+    ShmRing(void* base, std::uint64_t capacity):
+        hdr_(static_cast<ShmRingHeader*>(base)),
+        slots_(reinterpret_cast<T*>(static_cast<std::byte*>(base) + sizeof(ShmRingHeader))),
+        mask_(capacity - 1){}
+
+    static std::size_t bytes(std::uint64_t capacity){
+        const std::size_t raw = sizeof(ShmRingHeader) + capacity * sizeof(T);
+        return (raw + 63) & ~std::size_t{63};
+    }
+
+    bool push(const T& v){
+        const std::uint64_t head = hdr_->head.load(std::memory_order_relaxed);
+        if(head - cached_tail_ > mask_){
+            cached_tail_ = hdr_->tail.load(std::memory_order_acquire);
+            if(head - cached_tail_ > mask_){return false;}
+        }
+        slots_[head & mask_] = v;
+        hdr_->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& out){
+        const std::uint64_t tail = hdr_->tail.load(std::memory_order_relaxed);
+        if(tail == cached_head_){
+            cached_head_ = hdr_->head.load(std::memory_order_acquire);
+            if(tail == cached_head_){return false;}
+        }
+        out = slots_[tail & mask_];
+        hdr_->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //only while neither side uses the ring (slot being recycled)
+    void reset(){
+        hdr_->head.store(0, std::memory_order_relaxed);
+        hdr_->tail.store(0, std::memory_order_relaxed);
+        cached_head_ = 0;
+        cached_tail_ = 0;
+    }
+
+private:
+    ShmRingHeader* hdr_{nullptr};
+    T* slots_{nullptr};
+    std::uint64_t mask_{0};
+    std::uint64_t cached_head_{0};
+    std::uint64_t cached_tail_{0};
+};
+
+//slot lifecycle: Free -> Claimed (client filling in pid) -> Active -> Closing
+//(client done) -> Free. Active -> Expired when the heartbeat goes stale while
+//the process still exists: its orders are cancelled and the engine stops
+//polling, but the rings are left alone until the client closes or dies
+enum class ShmSlotState: std::uint32_t {Free, Claimed, Active, Closing, Expired};
+
+struct alignas(64) ShmSlot{
+    std::atomic<ShmSlotState> state;
+    std::int32_t pid;
+    std::atomic<std::int64_t> heartbeat_ns; //client's latencyNowNs() (CLOCK_MONOTONIC, system wide)
+    std::uint64_t generation;               //bumped on every release
+};
+
+struct ShmControl{
+    static constexpr std::uint64_t kMagic = 0x4f42534845504d31ull; //"OBSHEPM1"
+    static constexpr std::uint32_t kVersion = 3; //2: ExecReport seq / ts_ns, 3: trade_seq
+    static constexpr std::uint32_t kMaxSlots = 64;
+    static constexpr std::uint32_t kMaxSymbols = 256;
+    static constexpr std::size_t kSymbolChars = 16;
+
+    std::atomic<std::uint64_t> magic; //written last by the creator
+    std::uint32_t version;
+    std::uint32_t slot_count;
+    std::uint64_t ring_capacity;
+    std::int64_t liveness_timeout_ns; //0: only a closed slot or a dead pid ends a session
+    std::atomic<std::int64_t> engine_heartbeat_ns;
+    std::atomic<std::uint32_t> symbol_count;
+    char symbols[kMaxSymbols][kSymbolChars];
+    ShmSlot slots[kMaxSlots];
+
+    static std::size_t ringsOffset(){return (sizeof(ShmControl) + 63) & ~std::size_t{63};}
+    static std::size_t slotBytes(std::uint64_t capacity){
+        return ShmRing<SessionRequest>::bytes(capacity) + ShmRing<ExecReport>::bytes(capacity);
+    }
+    static std::size_t segmentBytes(std::uint32_t slots, std::uint64_t capacity){
+        return ringsOffset() + slots * slotBytes(capacity);
+    }
+    std::byte* requestRing(std::uint32_t slot){
+        return reinterpret_cast<std::byte*>(this) + ringsOffset() + slot * slotBytes(ring_capacity);
+    }
+    std::byte* reportRing(std::uint32_t slot){
+        return requestRing(slot) + ShmRing<SessionRequest>::bytes(ring_capacity);
+    }
+};
+
+namespace detail{
+
+struct ShmMapping{
+    void* addr{MAP_FAILED};
+    std::size_t bytes{0};
+
+    ShmMapping() = default;
+    ShmMapping(int fd, std::size_t n): bytes(n){
+        addr = ::mmap(nullptr, n, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ShmMapping(const ShmMapping&) = delete;
+    ShmMapping& operator=(const ShmMapping&) = delete;
+    ~ShmMapping(){
+        if(addr != MAP_FAILED){::munmap(addr, bytes);}
+    }
+    bool ok() const{return addr != MAP_FAILED;}
+};
+
+inline bool processAlive(std::int32_t pid){
+    return pid > 0 && !(::kill(pid, 0) < 0 && errno == ESRCH);
+}
+
+inline std::runtime_error shmError(const std::string& what, const std::string& name){
+    return std::runtime_error("shm " + name + ": " + what + ": " + std::strerror(errno));
+}
+
+}
+
+//engine side: creates the named segment (replacing a stale one) and serves its
+//slots as a SessionTransport. attach() it to an AsyncMatchingEngine after
+//publishing symbols; stop the engine before destroying it. Client-side death is
+//found by maintain() at most every 10 ms: a closed slot, a dead pid, or (with a
+//timeout) a stale heartbeat
+class ShmOrderEntry final: public SessionTransport{
+public:
+    ShmOrderEntry(std::string name, std::uint32_t slots = 16, std::uint64_t ring_capacity = 1 << 14,
+                  std::int64_t liveness_timeout_ns = 0):
+        name_(std::move(name)){
+        if(slots == 0 || slots > ShmControl::kMaxSlots){throw std::invalid_argument("shm: slot count");}
+        if(ring_capacity == 0 || (ring_capacity & (ring_capacity - 1)) != 0){
+            throw std::invalid_argument("shm: ring capacity must be a power of two");
+        }
+        ::shm_unlink(name_.c_str());
+        const int fd = ::shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if(fd < 0){throw detail::shmError("shm_open", name_);}
+        const std::size_t bytes = ShmControl::segmentBytes(slots, ring_capacity);
+        if(::ftruncate(fd, static_cast<off_t>(bytes)) < 0){
+            ::close(fd);
+            ::shm_unlink(name_.c_str());
+            throw detail::shmError("ftruncate", name_);
+        }
+        map_ = std::make_unique<detail::ShmMapping>(fd, bytes);
+        ::close(fd);
+        if(!map_->ok()){
+            ::shm_unlink(name_.c_str());
+            throw detail::shmError("mmap", name_);
+        }
+
+        //fresh pages are zero: every slot starts Free with empty rings
+        ctl_ = new(map_->addr) ShmControl{};
+        ctl_->version = ShmControl::kVersion;
+        ctl_->slot_count = slots;
+        ctl_->ring_capacity = ring_capacity;
+        ctl_->liveness_timeout_ns = liveness_timeout_ns;
+        requests_.resize(slots);
+        reports_.resize(slots);
+        claimed_since_.resize(slots, 0);
+        for(std::uint32_t i = 0; i < slots; ++i){
+            requests_[i] = ShmRing<SessionRequest>(new(ctl_->requestRing(i)) ShmRingHeader{}, ring_capacity);
+            reports_[i] = ShmRing<ExecReport>(new(ctl_->reportRing(i)) ShmRingHeader{}, ring_capacity);
+        }
+        ctl_->engine_heartbeat_ns.store(latencyNowNs(), std::memory_order_relaxed);
+        ctl_->magic.store(ShmControl::kMagic, std::memory_order_release);
+    }
+
+    ~ShmOrderEntry() override{::shm_unlink(name_.c_str());}
+
+    ShmOrderEntry(const ShmOrderEntry&) = delete;
+    ShmOrderEntry& operator=(const ShmOrderEntry&) = delete;
+
+    const std::string& name() const{return name_;}
+
+    //copy the engine's symbol names into the directory clients look up; call
+    //from the control thread whenever symbols were added
+    void publishSymbols(const MatchingEngine& engine){
+        const SymbolIndex& index = engine.symbolIndex();
+        const std::size_t n = std::min<std::size_t>(index.size(), ShmControl::kMaxSymbols);
+        for(std::size_t i = ctl_->symbol_count.load(std::memory_order_relaxed); i < n; ++i){
+            std::strncpy(ctl_->symbols[i], index.nameCStr(static_cast<SymbolId>(i)), ShmControl::kSymbolChars - 1);
+        }
+        ctl_->symbol_count.store(static_cast<std::uint32_t>(n), std::memory_order_release);
+    }
+
+    //clients with a live session (control-thread view, for monitoring)
+    std::uint32_t activeClients() const{
+        std::uint32_t n = 0;
+        for(std::uint32_t i = 0; i < ctl_->slot_count; ++i){n += live(i);}
+        return n;
+    }
+
+    //--- SessionTransport (engine thread) ---
+    std::uint32_t slots() const override{return ctl_->slot_count;}
+
+    bool live(std::uint32_t slot) const override{
+        return ctl_->slots[slot].state.load(std::memory_order_acquire) == ShmSlotState::Active;
+    }
+
+    bool pop(std::uint32_t slot, SessionRequest& req) override{return requests_[slot].pop(req);}
+    bool push(std::uint32_t slot, const ExecReport& r) override{return reports_[slot].push(r);}
+
+    void maintain(std::vector<std::uint32_t>& gone) override{
+        const std::int64_t now = latencyNowNs();
+        if(now - last_maintain_ns_ < kMaintainIntervalNs){return;}
+        last_maintain_ns_ = now;
+        ctl_->engine_heartbeat_ns.store(now, std::memory_order_relaxed);
+        for(std::uint32_t i = 0; i < ctl_->slot_count; ++i){
+            ShmSlot& slot = ctl_->slots[i];
+            const ShmSlotState st = slot.state.load(std::memory_order_acquire);
+            if(st != ShmSlotState::Claimed){claimed_since_[i] = 0;}
+            if(st == ShmSlotState::Closing ||
+               ((st == ShmSlotState::Active || st == ShmSlotState::Expired) && !detail::processAlive(slot.pid))){
+                gone.push_back(i);
+            }
+            else if(st == ShmSlotState::Claimed){
+                //a client that died between claiming and activating; pid may
+                //still be 0 right after the claim, hence the grace period
+                if(claimed_since_[i] == 0){claimed_since_[i] = now;}
+                else if(now - claimed_since_[i] > kClaimGraceNs && !detail::processAlive(slot.pid)){
+                    claimed_since_[i] = 0;
+                    gone.push_back(i);
+                }
+            }
+            else if(st == ShmSlotState::Active && ctl_->liveness_timeout_ns > 0 &&
+                    now - slot.heartbeat_ns.load(std::memory_order_relaxed) > ctl_->liveness_timeout_ns){
+                gone.push_back(i);
+            }
+        }
+    }
+
+    void release(std::uint32_t i) override{
+        ShmSlot& slot = ctl_->slots[i];
+        ShmSlotState expected = ShmSlotState::Active;
+        //hung but alive: stop serving it, keep its rings until it closes or dies
+        if(detail::processAlive(slot.pid) && slot.state.compare_exchange_strong(expected, ShmSlotState::Expired)){
+            return;
+        }
+        requests_[i].reset();
+        reports_[i].reset();
+        slot.pid = 0;
+        ++slot.generation;
+        slot.state.store(ShmSlotState::Free, std::memory_order_release);
+    }
+
+private:
+    static constexpr std::int64_t kMaintainIntervalNs = 10'000'000;
+    static constexpr std::int64_t kClaimGraceNs = 1'000'000'000;
+
+    std::string name_;
+    std::unique_ptr<detail::ShmMapping> map_;
+    ShmControl* ctl_{nullptr};
+    std::vector<ShmRing<SessionRequest>> requests_; //engine: consumer views
+    std::vector<ShmRing<ExecReport>> reports_;      //engine: producer views
+    std::vector<std::int64_t> claimed_since_;       //first maintain() that saw the slot Claimed
+    std::int64_t last_maintain_ns_{0};
+};
+
+//client side: opens the segment by name and claims a slot. requests / reports
+//have the StrategySession ring surface, so BasicAsyncOrderGateway<ShmClientSession>
+//drives it exactly like an in-process session. Call heartbeat() periodically
+//when the engine runs with a liveness timeout
+class ShmClientSession{
+public:
+    explicit ShmClientSession(const std::string& name){
+        const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if(fd < 0){throw detail::shmError("shm_open", name);}
+        struct stat st{};
+        if(::fstat(fd, &st) < 0 || static_cast<std::size_t>(st.st_size) < sizeof(ShmControl)){
+            ::close(fd);
+            throw std::runtime_error("shm " + name + ": not an order-entry segment");
+        }
+        map_ = std::make_unique<detail::ShmMapping>(fd, static_cast<std::size_t>(st.st_size));
+        ::close(fd);
+        if(!map_->ok()){throw detail::shmError("mmap", name);}
+        ctl_ = static_cast<ShmControl*>(map_->addr);
+        if(ctl_->magic.load(std::memory_order_acquire) != ShmControl::kMagic ||
+           ctl_->version != ShmControl::kVersion ||
+           ShmControl::segmentBytes(ctl_->slot_count, ctl_->ring_capacity) > map_->bytes){
+            throw std::runtime_error("shm " + name + ": segment not ready or incompatible");
+        }
+
+        for(std::uint32_t i = 0; i < ctl_->slot_count; ++i){
+            ShmSlotState expected = ShmSlotState::Free;
+            if(ctl_->slots[i].state.compare_exchange_strong(expected, ShmSlotState::Claimed,
+                                                             std::memory_order_acq_rel)){
+                slot_ = i;
+                break;
+            }
+        }
+        if(slot_ == kNoSlot){throw std::runtime_error("shm " + name + ": no free client slot");}
+
+        requests = ShmRing<SessionRequest>(ctl_->requestRing(slot_), ctl_->ring_capacity);
+        reports = ShmRing<ExecReport>(ctl_->reportRing(slot_), ctl_->ring_capacity);
+        ShmSlot& s = ctl_->slots[slot_];
+        s.pid = static_cast<std::int32_t>(::getpid());
+        s.heartbeat_ns.store(latencyNowNs(), std::memory_order_relaxed);
+        s.state.store(ShmSlotState::Active, std::memory_order_release);
+    }
+
+    ~ShmClientSession(){close();}
+
+    ShmClientSession(const ShmClientSession&) = delete;
+    ShmClientSession& operator=(const ShmClientSession&) = delete;
+
+    //hand the slot back; the engine cancels whatever is still resting
+    void close(){
+        if(slot_ == kNoSlot){return;}
+        ShmSlot& s = ctl_->slots[slot_];
+        ShmSlotState st = s.state.load(std::memory_order_acquire);
+        while((st == ShmSlotState::Active || st == ShmSlotState::Expired) &&
+              !s.state.compare_exchange_weak(st, ShmSlotState::Closing, std::memory_order_acq_rel)){}
+        slot_ = kNoSlot;
+    }
+
+    void heartbeat(){
+        ctl_->slots[slot_].heartbeat_ns.store(latencyNowNs(), std::memory_order_relaxed);
+    }
+
+    //the engine dropped this session (stale heartbeat); its orders were cancelled
+    bool expired() const{
+        return ctl_->slots[slot_].state.load(std::memory_order_acquire) == ShmSlotState::Expired;
+    }
+
+    bool engineAlive(std::int64_t timeout_ns) const{
+        return latencyNowNs() - ctl_->engine_heartbeat_ns.load(std::memory_order_relaxed) <= timeout_ns;
+    }
+
+    std::optional<SymbolId> symbol(const std::string& name) const{
+        const std::uint32_t n = ctl_->symbol_count.load(std::memory_order_acquire);
+        for(std::uint32_t i = 0; i < n; ++i){
+            if(std::strncmp(ctl_->symbols[i], name.c_str(), ShmControl::kSymbolChars) == 0){return i;}
+        }
+        return std::nullopt;
+    }
+
+    std::uint32_t slot() const{return slot_;}
+
+    ShmRing<SessionRequest> requests; //client: producer view
+    ShmRing<ExecReport> reports;      //client: consumer view
+
+private:
+    static constexpr std::uint32_t kNoSlot = 0xFFFFFFFFu;
+
+    std::unique_ptr<detail::ShmMapping> map_;
+    ShmControl* ctl_{nullptr};
+    std::uint32_t slot_{kNoSlot};
+};
+
+}
+
+#endif
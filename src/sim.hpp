@@ -0,0 +1,489 @@
+#pragma once
+
+#include "matching_engine.hpp"
+#include "market_maker.hpp"
+#include "backtest.hpp"
+#include "journal.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <vector>
+#include <boost/unordered/unordered_flat_map.hpp>
+
+namespace matching{
+
+using SimTime = std::int64_t; //virtual nanoseconds
+
+struct LatencyModel{
+    SimTime order_entry_ns{20'000};  //strategy → engine
+    SimTime market_data_ns{10'000};  //engine → strategy (BBO updates and fills)
+    SimTime engine_ns{500};          //per-event processing time (single server)
+    SimTime tape_spacing_ns{1'000};  //inter-arrival of tape events (journals carry no timestamps)
+};
+
+struct SimStats{
+    std::uint64_t tape_events{0};
+    std::uint64_t strategy_orders{0};
+    std::uint64_t market_data{0};
+    std::uint64_t fills{0};
+    std::uint64_t wakeups{0};
+    std::uint64_t scheduled{0};
+    std::uint64_t dropped{0}; //still in flight at session end
+    SimTime end_time{0};
+    SimTime max_engine_backlog{0};
+};
+
+//discrete-event simulation of makers trading against a replayed tape through
+//a latency model. Strategy orders reach the engine order_entry_ns after they
+//are sent, the engine serves one event per engine_ns, and BBO changes and fills
+//reach the strategy market_data_ns after the engine finishes the event. Quotes
+//therefore rest for a while before a cancel can take effect.
+//
+//The tape is already time-ordered, so it is merged with the priority queue
+//instead of being pushed through it; only strategy-generated events pay for heap ops
+class LatencySimulator{
+public:
+    //gateway handed to a maker: delayed book view and in-flight order entry.
+    //Makers see stable client order ids; the simulator maps them to engine ids
+    class Gateway{
+    public:
+        TopOfBook topOfBook(SymbolId) const{return sim_->makers_[maker_].view.toTopOfBook();}
+
+        OrderId newLimit(SymbolId symbol, UserId user, Side side, Price price, Qty qty,
+                         TimeInForce tif = TimeInForce::GFD){
+            InternalEvent e{};
+            e.type = EventType::NewLimit;
+            e.symbol = symbol;
+            e.user_id = user;
+            e.side = side;
+            e.price = price;
+            e.qty = qty;
+            e.tif = tif;
+            OrderId client = sim_->newClientId();
+            sim_->sendOrder(maker_, client, e);
+            return client;
+        }
+
+        bool cancel(SymbolId symbol, OrderId client){
+            InternalEvent e{};
+            e.type = EventType::Cancel;
+            e.symbol = symbol;
+            sim_->sendOrder(maker_, client, e);
+            return true;
+        }
+
+        OrderId amend(SymbolId symbol, OrderId client, Price price, Qty qty){
+            InternalEvent e{};
+            e.type = EventType::Replace; //carried as an amend of `client`
+            e.symbol = symbol;
+            e.price = price;
+            e.qty = qty;
+            sim_->sendOrder(maker_, client, e);
+            return client;
+        }
+
+    private:
+        friend class LatencySimulator;
+        Gateway(LatencySimulator* sim, std::uint32_t maker): sim_(sim), maker_(maker){}
+        LatencySimulator* sim_;
+        std::uint32_t maker_;
+    };
+
+    LatencySimulator(const EventTape& tape, LatencyModel model):
+        tape_(tape), model_(model),
+        engine_([this](const Trade& t){onEngineTrade(t);}),
+        tape_ids_(tape.symbols.size()){
+        engine_.setBookUpdateCallback([this](SymbolId sid){onBookUpdate(sid);});
+        for(const auto& name: tape.symbols){engine_.resolveSymbol(name);}
+        engine_to_client_.resize(tape.symbols.size());
+        clients_.push_back(ClientSlot{}); //client id 0 is never used
+        heap_.reserve(1 << 16);
+        slots_.reserve(1 << 16);
+    }
+
+    LatencySimulator(const LatencySimulator&) = delete;
+    LatencySimulator& operator=(const LatencySimulator&) = delete;
+
+    std::uint32_t addMaker(const MarketMakerConfig& config){
+        std::uint32_t idx = static_cast<std::uint32_t>(makers_.size());
+        makers_.emplace_back(config);
+        MakerState& m = makers_.back();
+        m.maker.attach(engine_);
+        SymbolId sid = m.maker.symbolId();
+        if(sid >= makers_by_symbol_.size()){makers_by_symbol_.resize(sid + 1);}
+        if(sid >= engine_to_client_.size()){engine_to_client_.resize(sid + 1);}
+        makers_by_symbol_[sid].push_back(idx);
+        scheduleWakeup(0, idx); //first quotes go out at t=0 against an empty view
+        return idx;
+    }
+
+    //runs until the session ends at the last tape event; strategy events still
+    //in flight then are dropped (a latency-bound strategy may otherwise keep
+    //chasing its own delayed quotes forever)
+    void run(){
+        const std::size_t n = tape_.events.size();
+        const SimTime session_end = n > 0 ? tapeTime(n - 1) : 0;
+        while(tape_pos_ < n || (!heap_.empty() && heap_.front().time <= session_end)){
+            const SimTime tape_time = tape_pos_ < n ? tapeTime(tape_pos_) : kNever;
+            if(!heap_.empty() && heap_.front().time < tape_time){
+                std::pop_heap(heap_.begin(), heap_.end(), Later{});
+                const HeapEntry top = heap_.back();
+                heap_.pop_back();
+                now_ = top.time;
+                const SimEvent ev = slots_[top.slot];
+                free_slots_.push_back(top.slot);
+                dispatch(ev);
+            }
+            else{
+                now_ = tape_time;
+                const std::size_t i = tape_pos_++;
+                InternalEvent e = tape_.events[i];
+                ++stats_.tape_events;
+                tape_ids_.resolve(e);
+                beginEngineEvent();
+                const OrderId live = engine_.processInternal(e);
+                if(tape_.assigned.empty()){tape_ids_.assigned(e, live);}
+                else{tape_ids_.assigned(e, live, tape_.assigned[i]);}
+            }
+        }
+        stats_.end_time = now_;
+        stats_.dropped = heap_.size();
+    }
+
+    const SimStats& stats() const{return stats_;}
+    std::size_t makerCount() const{return makers_.size();}
+    const SimpleMarketMaker& maker(std::uint32_t idx) const{return makers_[idx].maker;}
+    const MatchingEngine& engine() const{return engine_;}
+
+private:
+    static constexpr SimTime kNever = std::numeric_limits<SimTime>::max();
+
+    enum class SimEventKind: std::uint8_t {OrderArrival, MarketData, Fill, Wakeup};
+
+    //compact, trivially copyable top of book for event payloads
+    struct BboView{
+        Price bid;
+        Price ask;
+        Qty bid_qty;
+        Qty ask_qty;
+        bool has_bid;
+        bool has_ask;
+
+        static BboView from(const TopOfBook& tob){
+            BboView v{};
+            v.has_bid = tob.best_bid.has_value();
+            v.has_ask = tob.best_ask.has_value();
+            v.bid = tob.best_bid.value_or(0);
+            v.ask = tob.best_ask.value_or(0);
+            v.bid_qty = tob.bid_size.value_or(0);
+            v.ask_qty = tob.ask_size.value_or(0);
+            return v;
+        }
+
+        TopOfBook toTopOfBook() const{
+            TopOfBook tob{};
+            if(has_bid){tob.best_bid = bid; tob.bid_size = bid_qty;}
+            if(has_ask){tob.best_ask = ask; tob.ask_size = ask_qty;}
+            if(has_bid && has_ask){tob.mid_price = (bid + ask) / 2;}
+            return tob;
+        }
+    };
+
+    struct SimEvent{
+        SimTime time;
+        SimEventKind kind;
+        std::uint32_t maker;
+        OrderId client;
+        union{
+            InternalEvent order; //OrderArrival
+            Trade fill;          //Fill (ids rewritten to client ids)
+            BboView bbo;         //MarketData snapshot taken when the engine finished
+        };
+    };
+
+    //heap entries stay small; payloads live in a recycled slot array
+    struct HeapEntry{
+        SimTime time;
+        std::uint64_t seq; //FIFO among equal times
+        std::uint32_t slot;
+    };
+
+    struct Later{
+        bool operator()(const HeapEntry& a, const HeapEntry& b) const{
+            return a.time != b.time ? a.time > b.time : a.seq > b.seq;
+        }
+    };
+
+    struct MakerState{
+        explicit MakerState(const MarketMakerConfig& config): maker(config){}
+        SimpleMarketMaker maker;
+        BboView view{};       //latest delivered snapshot
+        bool wakeup_pending{false};
+    };
+
+    struct ClientRef{
+        std::uint32_t maker;
+        OrderId client;
+        Qty open; //engine order's open qty: at 0 the mapping goes
+    };
+
+    //a client id is a slot index in the low 32 bits and the slot's generation
+    //above it. A slot is reused once its engine order is gone; the generation
+    //bump turns the maker's late cancels/amends for the old id into no-ops
+    struct ClientSlot{
+        std::uint32_t gen{0};
+        OrderId engine_id{0}; //0 = not live
+    };
+
+    const EventTape& tape_;
+    LatencyModel model_;
+    MatchingEngine engine_;
+    TapeIdRemap tape_ids_;
+
+    std::deque<MakerState> makers_;
+    std::vector<std::vector<std::uint32_t>> makers_by_symbol_;
+
+    std::vector<ClientSlot> clients_;
+    std::vector<std::uint32_t> free_clients_;
+    std::vector<boost::unordered_flat_map<OrderId, ClientRef>> engine_to_client_; //per symbol
+
+    std::vector<HeapEntry> heap_;
+    std::vector<SimEvent> slots_;
+    std::vector<std::uint32_t> free_slots_;
+    std::uint64_t next_seq_{0};
+    std::size_t tape_pos_{0};
+    SimTime now_{0};
+    SimTime engine_free_at_{0};
+    SimTime engine_done_at_{0}; //completion time of the event being processed
+    SimStats stats_;
+
+    SimTime tapeTime(std::size_t i) const{return static_cast<SimTime>(i) * model_.tape_spacing_ns;}
+
+    void schedule(const SimEvent& ev){
+        std::uint32_t slot;
+        if(!free_slots_.empty()){
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+            slots_[slot] = ev;
+        }
+        else{
+            slot = static_cast<std::uint32_t>(slots_.size());
+            slots_.push_back(ev);
+        }
+        heap_.push_back(HeapEntry{ev.time, next_seq_++, slot});
+        std::push_heap(heap_.begin(), heap_.end(), Later{});
+        ++stats_.scheduled;
+    }
+
+    void scheduleWakeup(SimTime at, std::uint32_t maker){
+        MakerState& m = makers_[maker];
+        if(m.wakeup_pending){return;} //debounce: one requote per delivery batch
+        m.wakeup_pending = true;
+        SimEvent ev{};
+        ev.time = at;
+        ev.kind = SimEventKind::Wakeup;
+        ev.maker = maker;
+        schedule(ev);
+    }
+
+    OrderId newClientId(){
+        std::uint32_t idx;
+        if(!free_clients_.empty()){
+            idx = free_clients_.back();
+            free_clients_.pop_back();
+        }
+        else{
+            idx = static_cast<std::uint32_t>(clients_.size());
+            clients_.push_back(ClientSlot{});
+        }
+        return static_cast<OrderId>((static_cast<std::uint64_t>(clients_[idx].gen) << 32) | idx);
+    }
+
+    //the slot of a current client id, nullptr for a released one
+    ClientSlot* clientSlot(OrderId client){
+        const auto idx = static_cast<std::uint32_t>(client);
+        const auto gen = static_cast<std::uint32_t>(static_cast<std::uint64_t>(client) >> 32);
+        return idx < clients_.size() && clients_[idx].gen == gen ? &clients_[idx] : nullptr;
+    }
+
+    void releaseClient(OrderId client){
+        ClientSlot* slot = clientSlot(client);
+        if(!slot){return;}
+        slot->engine_id = 0;
+        slot->gen = (slot->gen + 1) & 0x7fffffffu; //ids stay positive
+        free_clients_.push_back(static_cast<std::uint32_t>(client));
+    }
+
+    void sendOrder(std::uint32_t maker, OrderId client, const InternalEvent& e){
+        SimEvent ev{};
+        ev.time = now_ + model_.order_entry_ns;
+        ev.kind = SimEventKind::OrderArrival;
+        ev.maker = maker;
+        ev.client = client;
+        ev.order = e;
+        schedule(ev);
+        ++stats_.strategy_orders;
+    }
+
+    //single-server engine: an event that arrives while busy waits its turn
+    void beginEngineEvent(){
+        const SimTime start = std::max(now_, engine_free_at_);
+        stats_.max_engine_backlog = std::max(stats_.max_engine_backlog, start - now_);
+        engine_done_at_ = start + model_.engine_ns;
+        engine_free_at_ = engine_done_at_;
+    }
+
+    void dispatch(const SimEvent& ev){
+        switch(ev.kind){
+        case SimEventKind::OrderArrival:
+            beginEngineEvent();
+            applyOrder(ev);
+            break;
+        case SimEventKind::MarketData:
+            ++stats_.market_data;
+            makers_[ev.maker].view = ev.bbo;
+            scheduleWakeup(now_, ev.maker);
+            break;
+        case SimEventKind::Fill:
+            ++stats_.fills;
+            if(ev.fill.buy_id != 0){
+                makers_[ev.maker].maker.onFill(Side::Buy, ev.fill.buy_id, ev.fill.price, ev.fill.qty);
+            }
+            else{
+                makers_[ev.maker].maker.onFill(Side::Sell, ev.fill.sell_id, ev.fill.price, ev.fill.qty);
+            }
+            scheduleWakeup(now_, ev.maker);
+            break;
+        case SimEventKind::Wakeup:{
+            ++stats_.wakeups;
+            MakerState& m = makers_[ev.maker];
+            m.wakeup_pending = false;
+            Gateway gw(this, ev.maker);
+            m.maker.onTick(gw);
+            break;
+        }
+        }
+    }
+
+    //the delayed view can be stale, so a quote may cross on arrival: the id the
+    //engine is about to assign is registered first so immediate fills are attributed
+    OrderId predictedId(SymbolId sid) const{
+        const auto* book = engine_.findBook(sid);
+        return book ? book->nextOrderId() : OrderId{1};
+    }
+
+    bool isResting(SymbolId sid, OrderId id) const{
+        const auto* book = engine_.findBook(sid);
+        return book && book->findOrder(id) != nullptr;
+    }
+
+    //the engine never grows clients_ from inside an order (makers only run on
+    //wakeups), so the slot pointer stays valid across the engine call
+    void applyOrder(const SimEvent& ev){
+        const SymbolId sid = ev.order.symbol;
+        auto& to_client = engine_to_client_[sid];
+        ClientSlot* slot = clientSlot(ev.client);
+        if(!slot){return;} //order already gone: a late cancel/amend
+        const ClientRef ref{ev.maker, ev.client, ev.order.qty};
+
+        switch(ev.order.type){
+        case EventType::NewLimit:{
+            OrderId predicted = predictedId(sid);
+            to_client[predicted] = ref;
+            OrderId id = engine_.newLimit(sid, ev.order.user_id, ev.order.side,
+                                          ev.order.price, ev.order.qty, ev.order.tif);
+            if(id == predicted && isResting(sid, id)){slot->engine_id = id;}
+            else{
+                to_client.erase(predicted);
+                releaseClient(ev.client);
+            }
+            break;
+        }
+        case EventType::Cancel:
+            if(slot->engine_id != 0){
+                engine_.cancel(sid, slot->engine_id);
+                to_client.erase(slot->engine_id);
+            }
+            releaseClient(ev.client);
+            break;
+        case EventType::Replace:
+            if(slot->engine_id != 0){
+                OrderId old_id = slot->engine_id;
+                OrderId predicted = predictedId(sid);
+                to_client[predicted] = ref;
+                OrderId id = engine_.amend(sid, old_id, ev.order.price, ev.order.qty, ev.order.user_id);
+                if(id == old_id){ //kept priority in place
+                    to_client.erase(predicted);
+                    if(auto it = to_client.find(id); it != to_client.end()){it->second.open = ev.order.qty;}
+                }
+                else{
+                    to_client.erase(old_id);
+                    if(id == predicted && isResting(sid, id)){slot->engine_id = id;}
+                    else{
+                        to_client.erase(predicted);
+                        releaseClient(ev.client);
+                    }
+                }
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    void onEngineTrade(const Trade& t){
+        if(t.symbol_id >= engine_to_client_.size()){return;}
+        auto& to_client = engine_to_client_[t.symbol_id];
+        if(to_client.empty()){return;}
+        if(auto it = to_client.find(t.buy_id); it != to_client.end()){
+            Trade fill = t;
+            fill.buy_id = it->second.client;
+            fill.sell_id = 0;
+            scheduleFill(it->second.maker, fill);
+            consumeFill(to_client, it, t.qty);
+        }
+        if(auto it = to_client.find(t.sell_id); it != to_client.end()){
+            Trade fill = t;
+            fill.buy_id = 0;
+            fill.sell_id = it->second.client;
+            scheduleFill(it->second.maker, fill);
+            consumeFill(to_client, it, t.qty);
+        }
+    }
+
+    //a fully filled order is no longer in the book: drop its mapping and free
+    //its client id
+    template<typename Map, typename It>
+    void consumeFill(Map& to_client, It it, Qty qty){
+        it->second.open -= qty;
+        if(it->second.open > 0){return;}
+        const OrderId client = it->second.client;
+        to_client.erase(it);
+        releaseClient(client);
+    }
+
+    void scheduleFill(std::uint32_t maker, const Trade& fill){
+        SimEvent ev{};
+        ev.time = engine_done_at_ + model_.market_data_ns;
+        ev.kind = SimEventKind::Fill;
+        ev.maker = maker;
+        ev.fill = fill;
+        schedule(ev);
+    }
+
+    void onBookUpdate(SymbolId sid){
+        if(sid >= makers_by_symbol_.size() || makers_by_symbol_[sid].empty()){return;}
+        SimEvent ev{};
+        ev.time = engine_done_at_ + model_.market_data_ns;
+        ev.kind = SimEventKind::MarketData;
+        ev.bbo = BboView::from(engine_.topOfBook(sid));
+        for(std::uint32_t maker: makers_by_symbol_[sid]){
+            ev.maker = maker;
+            schedule(ev);
+        }
+    }
+};
+
+}
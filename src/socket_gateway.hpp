@@ -0,0 +1,543 @@
+#pragma once
+
+#include "async_matching_engine.hpp"
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/unordered/unordered_flat_map.hpp>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace matching{
+
+//--- wire format: fixed-size frames, native byte order (local sockets only) ---
+
+enum class WireType: std::uint8_t {NewLimit = 'L', NewMarket = 'M', Cancel = 'C', Amend = 'A', Subscribe = 'S'};
+
+//client -> gateway. order_id is the client's own id for the order; Cancel and
+//Amend name the order to act on by that id
+struct WireRequest{
+    WireType type;
+    Side side;
+    TimeInForce tif;
+    std::uint8_t pad;
+    SymbolId symbol;
+    std::int64_t order_id;
+    std::int64_t price;
+    std::int64_t qty;
+};
+
+//gateway -> client: an ExecReport with the client's order id. Bbo uses
+//price/qty for the bid and ask_price/ask_qty for the ask. A cancel sent before
+//the order's Accepted is held and forwarded on the ack; an early amend is
+//Rejected (the order itself stays live)
+struct WireReport{
+    ReportType type;
+    Side side;
+    std::uint16_t pad;
+    SymbolId symbol;
+    std::int64_t order_id;
+    std::int64_t engine_id;
+    std::int64_t price;
+    std::int64_t qty;
+    std::int64_t ask_price;
+    std::int64_t ask_qty;
+    std::uint64_t seq;       //per connection from 1, without gaps
+    std::uint64_t trade_seq; //Fill: the engine's trade seq
+    std::int64_t ts_ns;      //the engine's report time (0 on gateway-local rejects)
+};
+
+static_assert(sizeof(WireRequest) == 32, "WireRequest layout");
+static_assert(sizeof(WireReport) == 80, "WireReport layout");
+
+//per-connection counters, kept after the connection closes
+struct ConnectionStats{
+    std::uint64_t requests{0};
+    std::uint64_t accepted{0};
+    std::uint64_t fills{0};
+    std::uint64_t rejects{0};
+    std::uint64_t reports{0};
+    std::uint64_t bytes_in{0};
+    std::uint64_t bytes_out{0};
+};
+
+//order-entry gateway thread: accepts local clients on a Unix domain socket,
+//reads frames with non-blocking I/O under epoll, and forwards each batch as
+//SessionRequests on its own engine session. Reports come back on that session
+//and are routed to the owning connection. A connection's open orders are
+//cancelled when it disconnects.
+//
+//Symbols are SymbolIds; resolve them on the engine before starting (ids the
+//engine did not know at start() are rejected). Frames with an invalid side,
+//tif or quantity are rejected at the gateway, and a client that stops reading
+//its reports is disconnected once kMaxPendingOut bytes are waiting for it
+class SocketGateway{
+public:
+    SocketGateway(AsyncMatchingEngine& engine, std::string path):
+        engine_(engine), session_(engine.connect()), path_(std::move(path)){
+        listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(listen_fd_ < 0){throw std::runtime_error("gateway: socket: " + std::string(std::strerror(errno)));}
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if(path_.size() >= sizeof(addr.sun_path)){throw std::runtime_error("gateway: socket path too long");}
+        std::memcpy(addr.sun_path, path_.c_str(), path_.size() + 1);
+        ::unlink(path_.c_str());
+        if(::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+           ::listen(listen_fd_, 128) < 0){
+            const std::string err = std::strerror(errno);
+            ::close(listen_fd_);
+            throw std::runtime_error("gateway: bind/listen " + path_ + ": " + err);
+        }
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u32 = kListenerTag;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+    }
+
+    ~SocketGateway(){
+        stop();
+        for(auto& c: conns_){
+            if(c && c->fd >= 0){::close(c->fd);}
+        }
+        ::close(epoll_fd_);
+        ::close(listen_fd_);
+        ::unlink(path_.c_str());
+    }
+
+    SocketGateway(const SocketGateway&) = delete;
+    SocketGateway& operator=(const SocketGateway&) = delete;
+
+    void start(){
+        symbol_count_ = engine_.engine().symbolIndex().size();
+        running_.store(true, std::memory_order_release);
+        thread_ = std::thread(&SocketGateway::run, this);
+    }
+
+    void stop(){
+        if(running_.exchange(false) && thread_.joinable()){thread_.join();}
+    }
+
+    const std::string& path() const{return path_;}
+
+    //stats of every connection seen so far; read after stop()
+    std::vector<ConnectionStats> connectionStats() const{
+        std::vector<ConnectionStats> out = closed_stats_;
+        for(const auto& c: conns_){
+            if(c && c->fd >= 0){out.push_back(c->stats);}
+        }
+        return out;
+    }
+
+private:
+    static constexpr std::uint32_t kListenerTag = 0xFFFFFFFFu;
+    static constexpr std::uint32_t kNoConn = 0xFFFFFFFFu;
+    static constexpr UserId kUserBase = 100000; //engine user id = base + connection slot
+    static constexpr std::size_t kReadChunk = 64 * 1024;
+    static constexpr std::size_t kMaxPendingOut = 4 << 20;
+
+    struct Connection{
+        int fd{-1};
+        std::vector<char> in;
+        std::vector<char> out;
+        std::size_t out_off{0};
+        bool want_write{false};
+        bool dirty{false};
+        bool overflow{false}; //unsent reports over kMaxPendingOut: closed on the next flush
+        std::uint64_t report_seq{0};
+        boost::unordered_flat_map<std::int64_t, OrderId> orders; //client order id -> route id
+        std::vector<SymbolId> subscriptions;
+        ConnectionStats stats;
+    };
+
+    struct Route{
+        std::uint32_t conn;
+        std::int64_t client_order_id;
+        OrderId engine_id;
+        SymbolId symbol;
+        Side side;
+        Qty open;
+        bool cancel_on_ack;
+    };
+
+    AsyncMatchingEngine& engine_;
+    StrategySession& session_;
+    std::string path_;
+    std::size_t symbol_count_{0};
+    int listen_fd_{-1};
+    int epoll_fd_{-1};
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    std::vector<std::unique_ptr<Connection>> conns_; //slot = epoll tag
+    std::vector<std::uint32_t> free_slots_;
+    std::vector<std::uint32_t> dirty_;
+    std::vector<ConnectionStats> closed_stats_;
+    boost::unordered_flat_map<OrderId, Route> routes_; //route id = session client id
+    OrderId next_route_id_{1};
+    std::vector<std::vector<std::uint32_t>> subscribers_; //per symbol
+    std::vector<bool> engine_subscribed_;                 //per symbol, Subscribe sent to the engine
+    std::vector<WireReport> last_bbo_;                    //per symbol, type Bbo once seen
+    std::vector<char> scratch_ = std::vector<char>(kReadChunk);
+
+    void run(){
+        epoll_event events[64];
+        int idle = 0;
+        while(running_.load(std::memory_order_acquire)){
+            //spin while busy; back off to a 1 ms wait once idle for a while
+            const int n = ::epoll_wait(epoll_fd_, events, 64, idle > 1000 ? 1 : 0);
+            for(int i = 0; i < n; ++i){
+                const std::uint32_t tag = events[i].data.u32;
+                if(tag == kListenerTag){acceptAll(); continue;}
+                if(!conns_[tag]){continue;} //closed earlier in this batch
+                if(events[i].events & (EPOLLHUP | EPOLLERR)){
+                    while(readConn(tag)){} //take what was sent before the hangup
+                    if(conns_[tag]){closeConn(tag);}
+                    continue;
+                }
+                if(events[i].events & EPOLLIN){readConn(tag);}
+                if(events[i].events & EPOLLOUT && conns_[tag]){flushConn(tag);}
+            }
+            const std::size_t reports = drainReports();
+            flushDirty();
+            if(n > 0 || reports > 0){idle = 0;}
+            else{
+                ++idle;
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void acceptAll(){
+        for(;;){
+            const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd < 0){return;}
+            std::uint32_t slot;
+            if(!free_slots_.empty()){
+                slot = free_slots_.back();
+                free_slots_.pop_back();
+            }
+            else{
+                slot = static_cast<std::uint32_t>(conns_.size());
+                conns_.emplace_back();
+            }
+            conns_[slot] = std::make_unique<Connection>();
+            conns_[slot]->fd = fd;
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u32 = slot;
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+        }
+    }
+
+    //false once nothing more can be read (would block or connection closed)
+    bool readConn(std::uint32_t slot){
+        Connection& c = *conns_[slot];
+        const ssize_t r = ::read(c.fd, scratch_.data(), scratch_.size());
+        if(r <= 0){
+            if(r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)){closeConn(slot);}
+            return false;
+        }
+        c.in.insert(c.in.end(), scratch_.data(), scratch_.data() + r);
+        c.stats.bytes_in += static_cast<std::uint64_t>(r);
+
+        //every complete frame in the buffer is one batch; a partial tail waits
+        const std::size_t frames = c.in.size() / sizeof(WireRequest);
+        for(std::size_t i = 0; i < frames; ++i){
+            WireRequest w;
+            std::memcpy(&w, c.in.data() + i * sizeof(WireRequest), sizeof(w));
+            handleRequest(slot, w);
+        }
+        c.in.erase(c.in.begin(), c.in.begin() + static_cast<std::ptrdiff_t>(frames * sizeof(WireRequest)));
+        return true;
+    }
+
+    //the fields a new order takes from the frame as they are
+    bool validNew(const WireRequest& w) const{
+        return w.symbol < symbol_count_ && w.qty > 0 &&
+               static_cast<std::uint8_t>(w.side) <= static_cast<std::uint8_t>(Side::Sell) &&
+               static_cast<std::uint8_t>(w.tif) <= static_cast<std::uint8_t>(TimeInForce::FOK);
+    }
+
+    void handleRequest(std::uint32_t slot, const WireRequest& w){
+        Connection& c = *conns_[slot];
+        ++c.stats.requests;
+        SessionRequest req{};
+        req.type = RequestType::Order;
+        req.event.symbol = w.symbol;
+        req.event.user_id = kUserBase + slot;
+        req.event.side = w.side;
+        req.event.tif = w.tif;
+        req.event.price = w.price;
+        req.event.qty = w.qty;
+
+        switch(w.type){
+        case WireType::NewLimit:
+        case WireType::NewMarket:{
+            if(!validNew(w) || c.orders.find(w.order_id) != c.orders.end()){ //or id still live
+                rejectLocal(slot, w);
+                return;
+            }
+            const OrderId route = next_route_id_++;
+            routes_[route] = Route{slot, w.order_id, 0, w.symbol, w.side, w.qty, false};
+            c.orders[w.order_id] = route;
+            req.client_id = route;
+            req.event.type = w.type == WireType::NewLimit ? EventType::NewLimit : EventType::NewMarket;
+            send(req);
+            return;
+        }
+        case WireType::Cancel:
+        case WireType::Amend:{
+            auto it = c.orders.find(w.order_id);
+            if(it == c.orders.end() || (w.type == WireType::Amend && w.qty <= 0)){rejectLocal(slot, w); return;}
+            Route& route = routes_[it->second];
+            if(route.engine_id == 0){ //not acknowledged yet
+                if(w.type == WireType::Cancel){route.cancel_on_ack = true;}
+                else{rejectLocal(slot, w);}
+                return;
+            }
+            req.client_id = it->second;
+            req.event.symbol = route.symbol;
+            req.event.side = route.side;
+            req.event.id = route.engine_id;
+            if(w.type == WireType::Cancel){req.event.type = EventType::Cancel;}
+            else{
+                req.type = RequestType::Amend;
+                req.event.type = EventType::Replace;
+            }
+            send(req);
+            return;
+        }
+        case WireType::Subscribe:
+            if(w.symbol >= symbol_count_){break;}
+            subscribe(slot, w.symbol);
+            return;
+        }
+        rejectLocal(slot, w);
+    }
+
+    void subscribe(std::uint32_t slot, SymbolId symbol){
+        if(symbol >= subscribers_.size()){
+            subscribers_.resize(symbol + 1);
+            engine_subscribed_.resize(symbol + 1, false);
+            last_bbo_.resize(symbol + 1, WireReport{ReportType::Rejected, Side::Buy, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+        }
+        auto& mine = conns_[slot]->subscriptions;
+        if(std::find(mine.begin(), mine.end(), symbol) != mine.end()){return;} //already subscribed
+        //the session stays subscribed once asked (there is no unsubscribe), so
+        //later first subscribers get the cached BBO instead of a second request
+        if(!engine_subscribed_[symbol]){
+            engine_subscribed_[symbol] = true;
+            SessionRequest req{};
+            req.type = RequestType::Subscribe;
+            req.event.symbol = symbol;
+            send(req);
+        }
+        else if(last_bbo_[symbol].type == ReportType::Bbo){write(slot, last_bbo_[symbol]);}
+        subscribers_[symbol].push_back(slot);
+        mine.push_back(symbol);
+    }
+
+    void send(const SessionRequest& req){
+        while(!session_.requests.push(req)){std::this_thread::yield();}
+    }
+
+    void sendCancel(OrderId route_id, const Route& route){
+        SessionRequest req{};
+        req.type = RequestType::Order;
+        req.client_id = route_id;
+        req.event.type = EventType::Cancel;
+        req.event.symbol = route.symbol;
+        req.event.side = route.side;
+        req.event.id = route.engine_id;
+        send(req);
+    }
+
+    void rejectLocal(std::uint32_t slot, const WireRequest& w){
+        write(slot, WireReport{ReportType::Rejected, w.side, 0, w.symbol, w.order_id, 0, 0, 0, 0, 0, 0, 0, 0});
+    }
+
+    std::size_t drainReports(){
+        std::size_t n = 0;
+        ExecReport r{};
+        while(session_.reports.pop(r)){
+            ++n;
+            if(r.type == ReportType::Bbo){
+                if(r.symbol >= subscribers_.size()){continue;}
+                WireReport w{ReportType::Bbo, Side::Buy, 0, r.symbol, 0, 0, r.price, r.qty, r.ask_price, r.ask_qty,
+                             0, 0, r.ts_ns};
+                last_bbo_[r.symbol] = w;
+                for(std::uint32_t slot: subscribers_[r.symbol]){write(slot, w);}
+                continue;
+            }
+            auto it = routes_.find(r.client_id);
+            if(it == routes_.end()){continue;}
+            Route& route = it->second;
+            bool final = false;
+            switch(r.type){
+            case ReportType::Accepted:
+                route.engine_id = r.order_id;
+                if(route.cancel_on_ack){sendCancel(r.client_id, route);}
+                break;
+            case ReportType::Amended:
+                route.engine_id = r.order_id;
+                route.open = r.qty;
+                final = route.open <= 0;
+                break;
+            case ReportType::Fill:
+                route.open -= r.qty;
+                final = route.open <= 0;
+                break;
+            default: final = true; break;
+            }
+            if(route.conn != kNoConn){
+                Connection& c = *conns_[route.conn];
+                c.stats.accepted += r.type == ReportType::Accepted;
+                c.stats.fills += r.type == ReportType::Fill;
+                c.stats.rejects += r.type == ReportType::Rejected;
+                write(route.conn, WireReport{r.type, r.side, 0, r.symbol, route.client_order_id, r.order_id,
+                                             r.price, r.qty, 0, 0, 0, r.trade_seq, r.ts_ns});
+                if(final){c.orders.erase(route.client_order_id);}
+            }
+            if(final){routes_.erase(it);}
+        }
+        return n;
+    }
+
+    void write(std::uint32_t slot, WireReport w){
+        Connection& c = *conns_[slot];
+        if(c.overflow){return;}
+        w.seq = ++c.report_seq;
+        if(c.out.size() - c.out_off >= kMaxPendingOut){c.overflow = true;}
+        const char* p = reinterpret_cast<const char*>(&w);
+        c.out.insert(c.out.end(), p, p + sizeof(w));
+        ++c.stats.reports;
+        if(!c.dirty){
+            c.dirty = true;
+            dirty_.push_back(slot);
+        }
+    }
+
+    void flushDirty(){
+        for(std::uint32_t slot: dirty_){
+            if(!conns_[slot]){continue;}
+            conns_[slot]->dirty = false;
+            if(conns_[slot]->overflow){closeConn(slot);}
+            else{flushConn(slot);}
+        }
+        dirty_.clear();
+    }
+
+    //one write per flush; leftovers wait for EPOLLOUT
+    void flushConn(std::uint32_t slot){
+        Connection& c = *conns_[slot];
+        if(c.out_off < c.out.size()){
+            const ssize_t r = ::write(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off);
+            if(r < 0 && errno != EAGAIN && errno != EWOULDBLOCK){
+                closeConn(slot);
+                return;
+            }
+            if(r > 0){
+                c.out_off += static_cast<std::size_t>(r);
+                c.stats.bytes_out += static_cast<std::uint64_t>(r);
+            }
+        }
+        if(c.out_off == c.out.size()){
+            c.out.clear();
+            c.out_off = 0;
+        }
+        const bool want = c.out_off < c.out.size();
+        if(want != c.want_write){
+            c.want_write = want;
+            epoll_event ev{};
+            ev.events = EPOLLIN | (want ? EPOLLOUT : 0u);
+            ev.data.u32 = slot;
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, c.fd, &ev);
+        }
+    }
+
+    //cancel-on-disconnect: the engine still answers, but reports are dropped
+    void closeConn(std::uint32_t slot){
+        std::unique_ptr<Connection> c = std::move(conns_[slot]);
+        if(!c){return;}
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, c->fd, nullptr);
+        ::close(c->fd);
+        for(const auto& kv: c->orders){
+            Route& route = routes_[kv.second];
+            route.conn = kNoConn;
+            if(route.engine_id == 0){route.cancel_on_ack = true;}
+            else{sendCancel(kv.second, route);}
+        }
+        for(SymbolId s: c->subscriptions){
+            auto& subs = subscribers_[s];
+            subs.erase(std::remove(subs.begin(), subs.end(), slot), subs.end());
+        }
+        closed_stats_.push_back(c->stats);
+        free_slots_.push_back(slot);
+    }
+};
+
+//blocking client for the load tool and tests
+class GatewayClient{
+public:
+    explicit GatewayClient(const std::string& path){
+        fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, path.c_str(), std::min(path.size() + 1, sizeof(addr.sun_path) - 1));
+        if(fd_ < 0 || ::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0){
+            throw std::runtime_error("gateway client: connect " + path + ": " + std::strerror(errno));
+        }
+    }
+
+    ~GatewayClient(){if(fd_ >= 0){::close(fd_);}}
+
+    GatewayClient(const GatewayClient&) = delete;
+    GatewayClient& operator=(const GatewayClient&) = delete;
+
+    void send(const WireRequest* frames, std::size_t count){
+        const char* p = reinterpret_cast<const char*>(frames);
+        std::size_t left = count * sizeof(WireRequest);
+        while(left > 0){
+            const ssize_t r = ::write(fd_, p, left);
+            if(r <= 0){throw std::runtime_error("gateway client: write failed");}
+            p += r;
+            left -= static_cast<std::size_t>(r);
+        }
+    }
+
+    //blocks for at least one report; appends every complete one received
+    void receive(std::vector<WireReport>& out){
+        char buf[64 * 1024];
+        const ssize_t r = ::read(fd_, buf, sizeof(buf));
+        if(r <= 0){throw std::runtime_error("gateway client: connection closed");}
+        pending_.insert(pending_.end(), buf, buf + r);
+        const std::size_t frames = pending_.size() / sizeof(WireReport);
+        for(std::size_t i = 0; i < frames; ++i){
+            WireReport w;
+            std::memcpy(&w, pending_.data() + i * sizeof(WireReport), sizeof(w));
+            out.push_back(w);
+        }
+        pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(frames * sizeof(WireReport)));
+    }
+
+private:
+    int fd_{-1};
+    std::vector<char> pending_;
+};
+
+}
+
+#endif
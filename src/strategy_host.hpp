@@ -0,0 +1,340 @@
+#pragma once
+
+#include "matching_engine.hpp"
+#include "market_maker.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace matching{
+
+//runs a fleet of SimpleMarketMaker-equivalent strategies (ladder included) on
+//the engine thread. State is struct-of-arrays indexed by slot; each maker's
+//ladder levels own a fixed range of the flat quote arrays. One maker per
+//symbol, so a dense SymbolId → slot table is the whole subscriber list.
+//
+//Requotes are event-driven through a DirtySymbols set, as in MarketMakerRouter:
+//a symbol is marked when its BBO moves (onBookUpdate, wired to the engine's
+//BookUpdateCallback) or one of its quotes fills. onTick prices every marked
+//maker's whole ladder in flat passes, then diffs it against the live quotes
+//and only touches the engine for levels that changed
+class StrategyHost{
+public:
+    static constexpr std::uint32_t kNoSlot = std::numeric_limits<std::uint32_t>::max();
+
+    void reserve(std::size_t n){
+        symbol_.reserve(n); user_.reserve(n); fair_value_.reserve(n); half_spread_.reserve(n);
+        max_inventory_.reserve(n); skew_step_.reserve(n); levels_.reserve(n); base_.reserve(n);
+        position_.reserve(n); cash_.reserve(n); bid_filled_.reserve(n); ask_filled_.reserve(n);
+        quote_updates_.reserve(n); bid_count_.reserve(n); ask_count_.reserve(n);
+    }
+
+    //returns the new slot, or nullopt if the symbol already has a maker
+    std::optional<std::uint32_t> add(MatchingEngine& engine, const MarketMakerConfig& config){
+        SymbolId sid = engine.resolveSymbol(config.symbol);
+        if(sid >= slot_by_symbol_.size()){
+            slot_by_symbol_.resize(sid + 1, kNoSlot);
+            dirty_.resize(sid + 1);
+        }
+        if(slot_by_symbol_[sid] != kNoSlot){return std::nullopt;}
+
+        const std::uint32_t slot = static_cast<std::uint32_t>(symbol_.size());
+        const std::uint32_t levels = static_cast<std::uint32_t>(std::max<std::size_t>(1, config.levels));
+        slot_by_symbol_[sid] = slot;
+        symbol_.push_back(sid);
+        user_.push_back(config.user_id);
+        fair_value_.push_back(config.fair_value);
+        half_spread_.push_back(config.half_spread_ticks);
+        max_inventory_.push_back(config.max_inventory);
+        skew_step_.push_back(config.inventory_skew_step);
+        levels_.push_back(levels);
+        base_.push_back(static_cast<std::uint32_t>(level_offset_.size()));
+        position_.push_back(0);
+        cash_.push_back(0);
+        bid_filled_.push_back(0);
+        ask_filled_.push_back(0);
+        quote_updates_.push_back(0);
+        bid_count_.push_back(0);
+        ask_count_.push_back(0);
+
+        //the ladder's shape depends on config only: offsets and sizes are fixed here
+        for(std::uint32_t i = 0; i < levels; ++i){
+            const Price n = static_cast<Price>(i);
+            level_offset_.push_back(n * config.level_spacing_ticks + config.spacing_growth_ticks * n * (n - 1) / 2);
+            level_qty_.push_back(std::max<Qty>(1, config.quote_qty + static_cast<Qty>(i) * config.level_qty_step));
+        }
+        bids_.resize(level_offset_.size());
+        asks_.resize(level_offset_.size());
+        desired_bid_.resize(level_offset_.size());
+        desired_ask_.resize(level_offset_.size());
+        next_.reserve(std::max<std::size_t>(next_.capacity(), levels));
+
+        dirty_.mark(sid); //first quotes on the next tick
+        return slot;
+    }
+
+    std::size_t size() const{return symbol_.size();}
+
+    std::uint32_t slotFor(SymbolId symbol) const{
+        return symbol < slot_by_symbol_.size() ? slot_by_symbol_[symbol] : kNoSlot;
+    }
+
+    //O(1) dispatch: only the maker subscribed to trade.symbol_id is touched
+    bool onTrade(const Trade& trade){
+        const std::uint32_t slot = slotFor(trade.symbol_id);
+        if(slot == kNoSlot){return false;}
+
+        bool touched = false;
+        if(applyFill(bids_.data() + base_[slot], bid_count_[slot], trade.buy_id, trade.qty)){
+            const long long notional = static_cast<long long>(trade.price) * static_cast<long long>(trade.qty);
+            position_[slot] += trade.qty;
+            cash_[slot] -= notional;
+            bid_filled_[slot] += trade.qty;
+            touched = true;
+        }
+        if(applyFill(asks_.data() + base_[slot], ask_count_[slot], trade.sell_id, trade.qty)){
+            const long long notional = static_cast<long long>(trade.price) * static_cast<long long>(trade.qty);
+            position_[slot] -= trade.qty;
+            cash_[slot] += notional;
+            ask_filled_[slot] += trade.qty;
+            touched = true;
+        }
+        if(touched){dirty_.mark(trade.symbol_id);}
+        return touched;
+    }
+
+    //BookUpdateCallback: the symbol's best bid/ask changed
+    void onBookUpdate(SymbolId symbol){
+        if(slotFor(symbol) != kNoSlot){dirty_.mark(symbol);}
+    }
+
+    //same quoting rule as SimpleMarketMaker::onTick for every marked maker:
+    //gather their tops of book, price the batch (top quotes, then every ladder
+    //level) in flat loops, then merge each ladder with its live quotes. Requotes
+    //that move a book mark it again for the next tick, which then finds nothing
+    //to change
+    void onTick(MatchingEngine& engine){
+        if(dirty_.empty()){return;}
+        dirty_.take(flushing_);
+        const std::size_t n = flushing_.size();
+        batch_.resize(n);
+        best_bid_.resize(n); best_ask_.resize(n); has_bid_.resize(n); has_ask_.resize(n);
+        top_bid_.resize(n); top_ask_.resize(n); quote_bid_.resize(n); quote_ask_.resize(n);
+
+        for(std::size_t b = 0; b < n; ++b){
+            const SymbolId sid = flushing_[b];
+            const TopOfBook tob = engine.topOfBook(sid);
+            batch_[b] = slot_by_symbol_[sid];
+            has_bid_[b] = tob.best_bid ? 1 : 0;
+            has_ask_[b] = tob.best_ask ? 1 : 0;
+            best_bid_[b] = tob.best_bid.value_or(0);
+            best_ask_[b] = tob.best_ask.value_or(0);
+        }
+
+        priceTops(n);
+        priceLadders(n);
+
+        for(std::size_t b = 0; b < n; ++b){
+            const std::uint32_t slot = batch_[b];
+            maintainLadder(engine, slot, bids_, bid_count_[slot], desired_bid_, Side::Buy, quote_bid_[b]);
+            maintainLadder(engine, slot, asks_, ask_count_[slot], desired_ask_, Side::Sell, quote_ask_[b]);
+        }
+    }
+
+    void cancelAll(MatchingEngine& engine){
+        for(std::uint32_t slot = 0; slot < symbol_.size(); ++slot){
+            const Quote* bids = bids_.data() + base_[slot];
+            const Quote* asks = asks_.data() + base_[slot];
+            for(std::uint32_t i = 0; i < bid_count_[slot]; ++i){engine.cancel(symbol_[slot], bids[i].id);}
+            for(std::uint32_t i = 0; i < ask_count_[slot]; ++i){engine.cancel(symbol_[slot], asks[i].id);}
+            bid_count_[slot] = 0;
+            ask_count_[slot] = 0;
+        }
+    }
+
+    MarketMakerStats stats(std::uint32_t slot) const{
+        MarketMakerStats s{};
+        s.position = position_[slot];
+        s.cash = cash_[slot];
+        s.bid_filled_qty = bid_filled_[slot];
+        s.ask_filled_qty = ask_filled_[slot];
+        s.quote_updates = quote_updates_[slot];
+        return s;
+    }
+
+    SymbolId symbolOf(std::uint32_t slot) const{return symbol_[slot];}
+
+private:
+    struct Quote{
+        OrderId id{0};
+        Price price{0};
+        Qty remaining{0};
+    };
+
+    //config (read-only after add)
+    std::vector<SymbolId> symbol_;
+    std::vector<UserId> user_;
+    std::vector<Price> fair_value_;
+    std::vector<Price> half_spread_;
+    std::vector<Qty> max_inventory_;
+    std::vector<Qty> skew_step_;
+    std::vector<std::uint32_t> levels_;
+    std::vector<std::uint32_t> base_;   //first ladder level in the flat level arrays
+    std::vector<Price> level_offset_;   //per level: distance from the top quote
+    std::vector<Qty> level_qty_;        //per level: size
+
+    //per-maker state
+    std::vector<Qty> position_;
+    std::vector<long long> cash_;
+    std::vector<Qty> bid_filled_;
+    std::vector<Qty> ask_filled_;
+    std::vector<std::uint64_t> quote_updates_;
+
+    //live quotes per level range, best level first; the count is the live prefix
+    std::vector<Quote> bids_;
+    std::vector<Quote> asks_;
+    std::vector<std::uint32_t> bid_count_;
+    std::vector<std::uint32_t> ask_count_;
+
+    std::vector<std::uint32_t> slot_by_symbol_;
+    DirtySymbols dirty_;
+
+    //per-tick scratch, reused across ticks (no allocation once the fleet was seen)
+    std::vector<SymbolId> flushing_;
+    std::vector<std::uint32_t> batch_; //batch index → slot
+    std::vector<Price> best_bid_;
+    std::vector<Price> best_ask_;
+    std::vector<std::uint8_t> has_bid_;
+    std::vector<std::uint8_t> has_ask_;
+    std::vector<Price> top_bid_;
+    std::vector<Price> top_ask_;
+    std::vector<std::uint8_t> quote_bid_;
+    std::vector<std::uint8_t> quote_ask_;
+    std::vector<Price> desired_bid_; //per level, written for the batch's makers
+    std::vector<Price> desired_ask_;
+    std::vector<Quote> next_;
+
+    //branch-free over the batch: config and state are gathered by slot, the
+    //book inputs and outputs are contiguous per batch index
+    void priceTops(std::size_t n){
+        const std::uint32_t* slot = batch_.data();
+        const Price* bb = best_bid_.data();
+        const Price* ba = best_ask_.data();
+        const std::uint8_t* hb = has_bid_.data();
+        const std::uint8_t* ha = has_ask_.data();
+        const Price* hs = half_spread_.data();
+        const Price* fv = fair_value_.data();
+        const Qty* pos = position_.data();
+        const Qty* step = skew_step_.data();
+        const Qty* max_inv = max_inventory_.data();
+
+        for(std::size_t b = 0; b < n; ++b){
+            const std::uint32_t i = slot[b];
+            const Price mid = (bb[b] + ba[b]) / 2;
+            const Price one_sided = hb[b] ? bb[b] + hs[i] : ba[b] - hs[i];
+            const Price fair = (hb[b] & ha[b]) ? mid : ((hb[b] | ha[b]) ? one_sided : fv[i]);
+            const Price skew = step[i] > 0 ? static_cast<Price>(pos[i] / step[i]) : 0;
+
+            Price bid = fair - hs[i] - skew;
+            Price ask = fair + hs[i] - skew;
+            bid = (ha[b] && bid >= ba[b]) ? ba[b] - 1 : bid;
+            ask = (hb[b] && ask <= bb[b]) ? bb[b] + 1 : ask;
+            ask = bid >= ask ? bid + 1 : ask;
+            top_bid_[b] = bid;
+            top_ask_[b] = ask;
+            quote_bid_[b] = pos[i] < max_inv[i] ? 1 : 0;
+            quote_ask_[b] = pos[i] > -max_inv[i] ? 1 : 0;
+        }
+    }
+
+    //every level of every batched ladder: bids step down, asks up from the top
+    void priceLadders(std::size_t n){
+        const Price* offset = level_offset_.data();
+        Price* out_bid = desired_bid_.data();
+        Price* out_ask = desired_ask_.data();
+        for(std::size_t b = 0; b < n; ++b){
+            const std::uint32_t base = base_[batch_[b]];
+            const std::uint32_t levels = levels_[batch_[b]];
+            const Price bid = top_bid_[b];
+            const Price ask = top_ask_[b];
+            for(std::uint32_t k = base; k < base + levels; ++k){
+                out_bid[k] = bid - offset[k];
+                out_ask[k] = ask + offset[k];
+            }
+        }
+    }
+
+    //merge of desired and live levels (both best-first), deciding as
+    //SimpleMarketMaker does: same price → keep or amend size in place, otherwise
+    //place or cancel. It runs twice, cancels first and then amends/placements in
+    //level order, so the book never holds the old and new top level at once
+    void maintainLadder(MatchingEngine& engine, std::uint32_t slot, std::vector<Quote>& quotes,
+                        std::uint32_t& count, const std::vector<Price>& desired, Side side, bool should_quote){
+        const std::uint32_t base = base_[slot];
+        const SymbolId symbol = symbol_[slot];
+        const std::uint32_t n = should_quote ? levels_[slot] : 0;
+        const Price* want = desired.data() + base;
+        const Qty* want_qty = level_qty_.data() + base;
+
+        //same-side cancels cannot change what a placement trades against, and
+        //placements only fill the other side: the live levels stay put across
+        //both passes
+        const Quote* active = quotes.data() + base;
+        std::uint32_t i = 0, j = 0;
+        while(i < n || j < count){
+            if(j < count && i < n && active[j].price == want[i]){++i; ++j;}
+            else if(j == count || (i < n && isBetter(side, want[i], active[j].price))){++i;}
+            else{engine.cancel(symbol, active[j++].id);}
+        }
+
+        next_.clear();
+        i = 0; j = 0;
+        while(i < n || j < count){
+            if(j < count && i < n && active[j].price == want[i]){
+                const Quote q = active[j];
+                if(q.remaining != want_qty[i]){
+                    const OrderId id = engine.amend(symbol, q.id, want[i], want_qty[i]);
+                    if(id != 0){
+                        next_.push_back(Quote{id, want[i], want_qty[i]});
+                        ++quote_updates_[slot];
+                    }
+                }
+                else{next_.push_back(q);}
+                ++i; ++j;
+            }
+            else if(j == count || (i < n && isBetter(side, want[i], active[j].price))){
+                const OrderId id = engine.newLimit(symbol, user_[slot], side, want[i], want_qty[i], TimeInForce::GFD);
+                if(id != 0){
+                    next_.push_back(Quote{id, want[i], want_qty[i]});
+                    ++quote_updates_[slot];
+                }
+                ++i;
+            }
+            else{++j;} //cancelled above
+        }
+        std::copy(next_.begin(), next_.end(), quotes.begin() + base);
+        count = static_cast<std::uint32_t>(next_.size());
+    }
+
+    static bool isBetter(Side side, Price a, Price b){
+        return side == Side::Buy ? a > b : a < b;
+    }
+
+    //removes a fully filled quote from the live prefix, keeping level order
+    static bool applyFill(Quote* quotes, std::uint32_t& count, OrderId id, Qty qty){
+        for(std::uint32_t i = 0; i < count; ++i){
+            if(quotes[i].id != id){continue;}
+            quotes[i].remaining -= qty;
+            if(quotes[i].remaining <= 0){
+                std::copy(quotes + i + 1, quotes + count, quotes + i);
+                --count;
+            }
+            return true;
+        }
+        return false;
+    }
+};
+
+}
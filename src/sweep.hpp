@@ -0,0 +1,76 @@
+#pragma once
+
+#include "backtest.hpp"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace matching{
+
+struct SweepResult{
+    MarketMakerConfig config;
+    BacktestSample final_stats;
+    std::uint64_t trades{0};
+    double seconds{0};
+};
+
+//cartesian product of the tuned MarketMakerConfig fields
+inline std::vector<MarketMakerConfig> makeSweepGrid(const MarketMakerConfig& base,
+                                                    const std::vector<Price>& half_spreads,
+                                                    const std::vector<Qty>& skew_steps,
+                                                    const std::vector<Qty>& max_inventories,
+                                                    const std::vector<Qty>& quote_qtys){
+    std::vector<MarketMakerConfig> grid;
+    grid.reserve(half_spreads.size() * skew_steps.size() * max_inventories.size() * quote_qtys.size());
+    for(Price hs: half_spreads){
+        for(Qty skew: skew_steps){
+            for(Qty max_inv: max_inventories){
+                for(Qty qty: quote_qtys){
+                    MarketMakerConfig c = base;
+                    c.half_spread_ticks = hs;
+                    c.inventory_skew_step = skew;
+                    c.max_inventory = max_inv;
+                    c.quote_qty = qty;
+                    grid.push_back(c);
+                }
+            }
+        }
+    }
+    return grid;
+}
+
+//runs one independent engine + maker backtest per config. The tape is parsed
+//once and shared read-only; workers claim the next job from an atomic counter,
+//so a slow parameter set never leaves other cores idle. Results keep grid order
+inline std::vector<SweepResult> runSweep(const EventTape& tape,
+                                         const std::vector<MarketMakerConfig>& grid,
+                                         unsigned threads){
+    std::vector<SweepResult> results(grid.size());
+    if(threads == 0){threads = std::max(1u, std::thread::hardware_concurrency());}
+    threads = std::min<unsigned>(threads, static_cast<unsigned>(std::max<std::size_t>(1, grid.size())));
+
+    std::atomic<std::size_t> next_job{0};
+    auto worker = [&](){
+        std::vector<MarketMakerConfig> one(1);
+        for(std::size_t job = next_job.fetch_add(1, std::memory_order_relaxed); job < grid.size();
+            job = next_job.fetch_add(1, std::memory_order_relaxed)){
+            one[0] = grid[job];
+            BacktestResult r = runBacktest(tape, one, 0);
+            SweepResult& out = results[job];
+            out.config = grid[job];
+            out.final_stats = r.final_stats.front();
+            out.trades = r.trades;
+            out.seconds = r.seconds;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for(unsigned t = 1; t < threads; ++t){pool.emplace_back(worker);}
+    worker();
+    for(auto& th: pool){th.join();}
+    return results;
+}
+
+}
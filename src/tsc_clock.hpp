@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace matching{
+
+//wall-clock nanoseconds (system_clock epoch) from the CPU's cycle counter: one
+//counter read and a multiply instead of a clock_gettime call. The rate is
+//calibrated once per process against system_clock, which assumes an invariant
+//counter (constant rate, synchronized across cores) as on current x86 and on
+//aarch64's virtual counter; elsewhere nowNs() is system_clock. The two drift
+//apart by a few ms per hour, so use it for ordering and latency, not for
+//matching timestamps across hosts
+class TscClock{
+public:
+    static std::int64_t nowNs(){return toNs(ticks());}
+
+    //raw counter reading, for stamping a hot path and converting only where the
+    //time is read (toNs); system_clock ns where there is no usable counter
+    static std::uint64_t ticks(){
+        #if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+        return counter();
+        #else
+        return static_cast<std::uint64_t>(systemNs());
+        #endif
+    }
+
+    static std::int64_t toNs(std::uint64_t t){
+        #if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+        const Calibration& c = calibration();
+        const std::uint64_t ticks = t - c.ticks0;
+        return c.ns0 + static_cast<std::int64_t>((static_cast<__int128>(static_cast<std::int64_t>(ticks)) * c.mult) >> kShift);
+        #else
+        return static_cast<std::int64_t>(t);
+        #endif
+    }
+
+    //pays the calibration (about 10 ms) up front instead of on the first nowNs()
+    static void calibrate(){(void)calibration();}
+
+private:
+    static constexpr int kShift = 32;
+
+    struct Calibration{
+        std::uint64_t ticks0;
+        std::int64_t ns0;
+        std::uint64_t mult; //ns per tick, fixed point with kShift fraction bits
+    };
+
+    static std::int64_t systemNs(){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    static std::uint64_t counter(){
+        #if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+        #elif defined(__aarch64__)
+        std::uint64_t v;
+        asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+        return v;
+        #else
+        return 0;
+        #endif
+    }
+
+    static const Calibration& calibration(){
+        static const Calibration c = [](){
+            const std::uint64_t t0 = counter();
+            const std::int64_t ns0 = systemNs();
+            const auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+            while(std::chrono::steady_clock::now() < until){}
+            const std::uint64_t t1 = counter();
+            const std::int64_t ns1 = systemNs();
+            const std::uint64_t ticks = t1 > t0 ? t1 - t0 : 1;
+            const auto ns = static_cast<std::uint64_t>(ns1 > ns0 ? ns1 - ns0 : 1);
+            return Calibration{t1, ns1, static_cast<std::uint64_t>((static_cast<unsigned __int128>(ns) << kShift) / ticks)};
+        }();
+        return c;
+    }
+};
+
+}